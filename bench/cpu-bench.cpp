@@ -0,0 +1,84 @@
+// cpu-bench.cpp : CPU::execute dispatch throughput on synthetic programs,
+// 1000 instructions per iteration. The "realtime" counter is how many NES
+// CPUs (1.79 MHz) one core keeps up with.
+//
+#include "program.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+constexpr double CPU_HZ = 1789773.0;
+constexpr int BATCH = 1000;
+
+void run(benchmark::State &state, bench::Machine &machine)
+{
+    uint64_t cycles = 0;
+    for (auto _ : state) {
+        cycles += machine.run(BATCH);
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+    state.counters["realtime"] = benchmark::Counter(double(cycles) / CPU_HZ,
+                                                    benchmark::Counter::kIsRate);
+}
+
+/// 4096 instructions of mix.
+void dispatch(benchmark::State &state, bench::Mix mix, bool block_cache)
+{
+    std::vector<uint8_t> program;
+    bench::append_mix(program, mix, 4096, 0x6502);
+    bench::Machine machine(program);
+    machine.cpu.set_block_cache(block_cache);
+    run(state, machine);
+}
+
+void BM_Dispatch(benchmark::State &state, bench::Mix mix) { dispatch(state, mix, false); }
+BENCHMARK_CAPTURE(BM_Dispatch, load_store, bench::Mix::LoadStore);
+BENCHMARK_CAPTURE(BM_Dispatch, alu, bench::Mix::Alu);
+BENCHMARK_CAPTURE(BM_Dispatch, rmw, bench::Mix::ReadModifyWrite);
+BENCHMARK_CAPTURE(BM_Dispatch, branch, bench::Mix::Branch);
+BENCHMARK_CAPTURE(BM_Dispatch, all, bench::Mix::All);
+
+/// Same programs run from the block cache.
+void BM_DispatchBlocks(benchmark::State &state, bench::Mix mix) { dispatch(state, mix, true); }
+BENCHMARK_CAPTURE(BM_DispatchBlocks, load_store, bench::Mix::LoadStore);
+BENCHMARK_CAPTURE(BM_DispatchBlocks, alu, bench::Mix::Alu);
+BENCHMARK_CAPTURE(BM_DispatchBlocks, rmw, bench::Mix::ReadModifyWrite);
+BENCHMARK_CAPTURE(BM_DispatchBlocks, branch, bench::Mix::Branch);
+BENCHMARK_CAPTURE(BM_DispatchBlocks, all, bench::Mix::All);
+
+/// 4096 copies of an instruction using the addressing mode under test.
+void BM_AddrMode(benchmark::State &state, uint8_t opcode)
+{
+    std::vector<uint8_t> program;
+    bench::append_repeated(program, opcode, 4096);
+    bench::Machine machine(program);
+    if (cpu::OPCODES[opcode].mode == cpu::AddrMode::Indirect) {
+        // Every JMP ($xxxx) lands on the first one.
+        for (int page = 0x02; page < 0x08; page++) {
+            for (int i = 0; i < 256; i += 2) {
+                machine.ram[page * 256 + i] = 0x00;
+                machine.ram[page * 256 + i + 1] = 0x80;
+            }
+        }
+    }
+    run(state, machine);
+}
+BENCHMARK_CAPTURE(BM_AddrMode, implied, uint8_t(0xe8));             // INX
+BENCHMARK_CAPTURE(BM_AddrMode, accumulator, uint8_t(0x0a));         // ASL A
+BENCHMARK_CAPTURE(BM_AddrMode, immediate, uint8_t(0xa9));           // LDA #
+BENCHMARK_CAPTURE(BM_AddrMode, zero_page, uint8_t(0xa5));           // LDA zp
+BENCHMARK_CAPTURE(BM_AddrMode, zero_page_x, uint8_t(0xb5));         // LDA zp,X
+BENCHMARK_CAPTURE(BM_AddrMode, zero_page_y, uint8_t(0xb6));         // LDX zp,Y
+BENCHMARK_CAPTURE(BM_AddrMode, relative, uint8_t(0xd0));            // BNE
+BENCHMARK_CAPTURE(BM_AddrMode, absolute, uint8_t(0xad));            // LDA abs
+BENCHMARK_CAPTURE(BM_AddrMode, absolute_x, uint8_t(0xbd));          // LDA abs,X
+BENCHMARK_CAPTURE(BM_AddrMode, absolute_y, uint8_t(0xb9));          // LDA abs,Y
+BENCHMARK_CAPTURE(BM_AddrMode, indirect, uint8_t(0x6c));            // JMP (abs)
+BENCHMARK_CAPTURE(BM_AddrMode, indexed_indirect, uint8_t(0xa1));    // LDA (zp,X)
+BENCHMARK_CAPTURE(BM_AddrMode, indirect_indexed, uint8_t(0xb1));    // LDA (zp),Y
+
+}   // Anonymous namespace.
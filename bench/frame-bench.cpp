@@ -0,0 +1,127 @@
+// frame-bench.cpp : Whole-console throughput, one frame per iteration, and the
+// benchmark driver.
+//
+//   nes-bench [benchmark flags] [rom...]
+//
+// Every ROM given gets a BM_Frame/<name> benchmark next to BM_Frame/synthetic,
+// which runs a generated ROM so there is always a number to compare.
+// BM_RunAhead/synthetic/<n> is the same with n frames of run-ahead. The
+// "realtime" counter is how many consoles (60.1 frames/s) one core keeps up
+// with. --benchmark_out=<file> --benchmark_out_format=json writes results for
+// tracking across commits, the bench-json target does that.
+//
+#include "console.h"
+#include "program.h"
+#include "run-ahead.h"
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr double FRAME_HZ = 60.0988;
+
+/// Writes an NROM cartridge to path that renders random tiles and sprites
+/// while the CPU runs ALU and branch code that only reads RAM, so the
+/// workload doesn't depend on what the PPU or the mappers do with stray
+/// writes. NMI comes every frame and runs a bare RTI. The APU's frame IRQ
+/// is inhibited, the code clears I and nothing would acknowledge it.
+bool write_synthetic_rom(const fs::path &path)
+{
+    std::vector<uint8_t> code = {
+        0xa9, 0x1e, 0x8d, 0x01, 0x20,   // LDA #$1E, STA $2001
+        0xa9, 0x88, 0x8d, 0x00, 0x20,   // LDA #$88, STA $2000
+        0xa9, 0x40, 0x8d, 0x17, 0x40,   // LDA #$40, STA $4017
+    };
+    const size_t loop = code.size();
+    for (uint32_t seed = 0; seed < 4; seed++) {
+        bench::append_mix(code, (seed % 2) ? bench::Mix::Branch : bench::Mix::Alu, 1024, seed);
+    }
+    code.insert(code.end(), { 0x4c, uint8_t(0x8000 + loop), uint8_t((0x8000 + loop) >> 8) });
+    const size_t rti = code.size();
+    code.push_back(0x40);
+
+    std::vector<uint8_t> prg(16 * 1024, 0xea);
+    std::copy(code.begin(), code.end(), prg.begin());
+    const uint16_t nmi = uint16_t(0x8000 + rti);
+    const uint8_t vectors[6] = { uint8_t(nmi), uint8_t(nmi >> 8), 0x00, 0x80, uint8_t(nmi), uint8_t(nmi >> 8) };
+    std::copy(vectors, vectors + 6, prg.end() - 6);
+
+    std::vector<uint8_t> chr(8 * 1024);
+    std::mt19937 rng(0x2c02);
+    for (uint8_t &b : chr) {
+        b = uint8_t(rng());
+    }
+
+    const uint8_t header[16] = { 'N', 'E', 'S', 0x1a, 1, 1, 0x01 };
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(prg.data()), std::streamsize(prg.size()));
+    out.write(reinterpret_cast<const char *>(chr.data()), std::streamsize(chr.size()));
+    return bool(out);
+}
+
+void BM_Frame(benchmark::State &state, const std::string &path, unsigned run_ahead)
+{
+    RunAhead runner(run_ahead);
+    auto console = std::make_unique<Console>();
+    if (console->load(path) != NesError::Success) {
+        state.SkipWithError("Could not load the ROM");
+        return;
+    }
+    // Get past the boot code.
+    for (int i = 0; i < 10; i++) {
+        if (console->run_frame() != NesError::Success) {
+            state.SkipWithError("Invalid opcode");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        if (runner.run_frame(*console) != NesError::Success) {
+            state.SkipWithError("Invalid opcode");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["realtime"] = benchmark::Counter(double(state.iterations()) / FRAME_HZ,
+                                                    benchmark::Counter::kIsRate);
+}
+
+}   // Anonymous namespace.
+
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+
+    const fs::path synthetic = fs::temp_directory_path() / fmt::format("nes-bench-{:08x}.nes", std::random_device()());
+    if (!write_synthetic_rom(synthetic)) {
+        fmt::print(stderr, "Failed to write {}\n", synthetic.string());
+        return 1;
+    }
+    benchmark::RegisterBenchmark("BM_Frame/synthetic", BM_Frame, synthetic.string(), 0u);
+    for (unsigned frames = 1; frames <= 2; frames++) {
+        const std::string name = fmt::format("BM_RunAhead/synthetic/{}", frames);
+        benchmark::RegisterBenchmark(name.c_str(), BM_Frame, synthetic.string(), frames);
+    }
+    for (int i = 1; i < argc; i++) {
+        const std::string name = "BM_Frame/" + fs::path(argv[i]).stem().string();
+        benchmark::RegisterBenchmark(name.c_str(), BM_Frame, std::string(argv[i]), 0u);
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    fs::remove(synthetic);
+    return 0;
+}
@@ -0,0 +1,75 @@
+// ppu-bench.cpp : PPU rendering cost with random pattern tables, nametables and
+// sprites, one scanline (341 dots) per iteration. Iterations walk through the
+// whole frame, so vblank lines are part of the average like they are in a
+// game.
+//
+#include "cartridge.h"
+#include "ppu/ppu.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+
+namespace {
+
+struct Scene {
+    uint8_t chr[8 * 1024];
+    std::unique_ptr<ppu::PPU> ppu;
+
+    /// mask is written to PPUMASK.
+    explicit Scene(uint8_t mask)
+        : ppu(std::make_unique<ppu::PPU>())
+    {
+        std::mt19937 rng(0x2c02);
+        for (uint8_t &b : chr) {
+            b = uint8_t(rng());
+        }
+        ppu->set_chr_memory(chr, sizeof(chr));
+        for (int slot = 0; slot < 8; slot++) {
+            ppu->map_chr(slot, &chr[slot * 1024]);
+        }
+        ppu->set_mirroring(Mirroring::Vertical);
+
+        // Nametables, attribute tables and palettes.
+        ppu->write(0x2006, 0x20);
+        ppu->write(0x2006, 0x00);
+        for (int i = 0; i < 0x800; i++) {
+            ppu->write(0x2007, uint8_t(rng()));
+        }
+        ppu->write(0x2006, 0x3f);
+        ppu->write(0x2006, 0x00);
+        for (int i = 0; i < 32; i++) {
+            ppu->write(0x2007, uint8_t(rng() & 0x3f));
+        }
+        ppu->write(0x2003, 0x00);
+        for (int i = 0; i < 256; i++) {
+            ppu->write(0x2004, uint8_t(rng()));
+        }
+
+        // Sprites from $1000, scrolled to (0, 0).
+        ppu->write(0x2000, 0x08);
+        ppu->write(0x2005, 0x00);
+        ppu->write(0x2005, 0x00);
+        ppu->write(0x2001, mask);
+    }
+};
+
+void BM_PpuScanline(benchmark::State &state)
+{
+    Scene scene(uint8_t(state.range(0)));
+    for (auto _ : state) {
+        scene.ppu->run(341);
+    }
+    benchmark::DoNotOptimize(scene.ppu->frame());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PpuScanline)
+    ->ArgName("mask")
+    ->Arg(0x00)     // Rendering off.
+    ->Arg(0x0a)     // Background.
+    ->Arg(0x14)     // Sprites.
+    ->Arg(0x1e);    // Both.
+
+}   // Anonymous namespace.
@@ -0,0 +1,158 @@
+// program.cpp
+//
+#include "program.h"
+
+#include <cassert>
+#include <cstring>
+#include <random>
+
+namespace bench {
+
+using cpu::AddrMode;
+using cpu::Instr;
+using cpu::OPCODES;
+
+bool in_mix(Instr instr, Mix mix)
+{
+    switch (mix) {
+    case Mix::LoadStore:
+        switch (instr) {
+        case Instr::LDA: case Instr::LDX: case Instr::LDY:
+        case Instr::STA: case Instr::STX: case Instr::STY:
+        case Instr::TAX: case Instr::TAY: case Instr::TXA: case Instr::TYA:
+        case Instr::TSX: case Instr::TXS:
+            return true;
+        default:
+            return false;
+        }
+    case Mix::Alu:
+        switch (instr) {
+        case Instr::ADC: case Instr::SBC: case Instr::AND: case Instr::ORA:
+        case Instr::EOR: case Instr::BIT: case Instr::CMP: case Instr::CPX:
+        case Instr::CPY: case Instr::INX: case Instr::INY: case Instr::DEX:
+        case Instr::DEY: case Instr::CLC: case Instr::SEC: case Instr::CLV:
+        case Instr::CLD: case Instr::SED: case Instr::CLI: case Instr::SEI:
+            return true;
+        default:
+            return false;
+        }
+    case Mix::ReadModifyWrite:
+        switch (instr) {
+        case Instr::ASL: case Instr::LSR: case Instr::ROL: case Instr::ROR:
+        case Instr::INC: case Instr::DEC:
+            return true;
+        default:
+            return false;
+        }
+    case Mix::Branch:
+        switch (instr) {
+        case Instr::BCC: case Instr::BCS: case Instr::BEQ: case Instr::BNE:
+        case Instr::BMI: case Instr::BPL: case Instr::BVC: case Instr::BVS:
+        case Instr::CMP:
+            return true;
+        default:
+            return false;
+        }
+    case Mix::All:
+        switch (instr) {
+        case Instr::Invalid: case Instr::BRK: case Instr::JMP: case Instr::JSR:
+        case Instr::RTS: case Instr::RTI:
+            return false;
+        default:
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+void append_instruction(std::vector<uint8_t> &code, uint8_t opcode, std::mt19937 &rng)
+{
+    code.push_back(opcode);
+    switch (OPCODES[opcode].mode) {
+    case AddrMode::Implied:
+    case AddrMode::Accumulator:
+        break;
+    case AddrMode::Relative:
+        code.push_back(0x00);
+        break;
+    case AddrMode::Absolute:
+    case AddrMode::AbsoluteX:
+    case AddrMode::AbsoluteY:
+    case AddrMode::Indirect:
+        // Somewhere in $0200-$07FF, clear of the zero page pointers.
+        code.push_back(uint8_t(rng()));
+        code.push_back(uint8_t(0x02 + rng() % 6));
+        break;
+    default:
+        code.push_back(uint8_t(rng()));
+        break;
+    }
+}
+
+}   // Anonymous namespace.
+
+void append_mix(std::vector<uint8_t> &code, Mix mix, int count, uint32_t seed)
+{
+    std::vector<uint8_t> opcodes;
+    for (int op = 0; op < 256; op++) {
+        // Unofficial opcodes other than the NOPs stay out, games hardly use
+        // them and the mixes keep comparing with earlier results.
+        if (cpu::unofficial(uint8_t(op)) && OPCODES[op].instr != Instr::NOP) {
+            continue;
+        }
+        if (in_mix(OPCODES[op].instr, mix)) {
+            opcodes.push_back(uint8_t(op));
+        }
+    }
+
+    std::mt19937 rng(seed);
+    for (int i = 0; i < count; i++) {
+        append_instruction(code, opcodes[rng() % opcodes.size()], rng);
+    }
+}
+
+void append_repeated(std::vector<uint8_t> &code, uint8_t opcode, int count)
+{
+    std::mt19937 rng(opcode);
+    for (int i = 0; i < count; i++) {
+        append_instruction(code, opcode, rng);
+    }
+}
+
+Machine::Machine(const std::vector<uint8_t> &program)
+    : cpu(bus)
+{
+    // Room for the JMP and the vectors.
+    assert(program.size() <= sizeof(rom) - 9);
+
+    std::memset(ram, 0x00, sizeof(ram));
+    for (int i = 0; i < 256; i += 2) {
+        ram[i] = uint8_t(i);
+        ram[i + 1] = uint8_t(0x02 + (i / 2) % 6);
+    }
+
+    std::memset(rom, 0xea, sizeof(rom));
+    std::memcpy(rom, program.data(), program.size());
+    const uint8_t jmp[3] = { 0x4c, 0x00, 0x80 };
+    std::memcpy(&rom[program.size()], jmp, sizeof(jmp));
+    // NMI, reset and IRQ all go to $8000.
+    const uint8_t vectors[6] = { 0x00, 0x80, 0x00, 0x80, 0x00, 0x80 };
+    std::memcpy(&rom[sizeof(rom) - 6], vectors, sizeof(vectors));
+
+    bus.map_memory(0x00, 0x20, ram, sizeof(ram));
+    bus.map_read(0x80, 0x80, rom, sizeof(rom));
+    cpu.reset();
+}
+
+uint64_t Machine::run(int count)
+{
+    uint64_t cycles = 0;
+    for (int i = 0; i < count; i++) {
+        cycles += cpu.step();
+    }
+    return cycles;
+}
+
+}   // Namespace bench.
@@ -0,0 +1,54 @@
+// program.h : Synthetic 6502 programs for the benchmarks. Programs are random
+// but seeded, so every run executes the same instructions.
+//
+#pragma once
+
+#include "bus.h"
+#include "cpu/cpu.h"
+#include "cpu/opcodes.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace bench {
+
+/// Instruction classes a program draws its opcodes from.
+enum class Mix {
+    LoadStore,          // Loads, stores and register transfers.
+    Alu,                // Arithmetic, logic, compares and flag changes.
+    ReadModifyWrite,    // Shifts, rotates, INC and DEC.
+    Branch,             // Branches, half taken thanks to interleaved compares.
+    All,                // Every implemented opcode but jumps, calls and returns.
+};
+
+/// True if instr belongs to mix.
+bool in_mix(cpu::Instr instr, Mix mix);
+
+/// Appends count instructions drawn from mix. Branches skip 0 bytes, so
+/// execution falls through to the next instruction either way.
+void append_mix(std::vector<uint8_t> &code, Mix mix, int count, uint32_t seed);
+
+/// Appends count copies of opcode. Absolute operands address RAM, relative
+/// ones are 0.
+void append_repeated(std::vector<uint8_t> &code, uint8_t opcode, int count);
+
+/// A CPU with 2kB of RAM at $0000 (mirrored up to $1FFF) and 32kB of ROM at
+/// $8000 holding a program followed by JMP $8000. Nothing else is mapped.
+class Machine {
+public:
+    /// RAM starts out with zero page pointers into RAM.
+    explicit Machine(const std::vector<uint8_t> &program);
+    Machine(const Machine&) = delete;
+    Machine &operator=(const Machine&) = delete;
+
+    /// Runs count instructions with CPU::step() and returns the cycles they
+    /// took.
+    uint64_t run(int count);
+
+    uint8_t ram[2 * 1024];
+    uint8_t rom[32 * 1024];
+    bus::Bus bus;
+    cpu::CPU cpu;
+};
+
+}   // Namespace bench.
@@ -0,0 +1,62 @@
+// tile-bench.cpp : Pattern table decoding throughput, one scanline (33 tiles)
+// per iteration.
+//
+#include "ppu/tile.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+
+namespace {
+
+struct Scanline {
+    uint8_t low[33];
+    uint8_t high[33];
+    uint8_t attr[33];
+    uint8_t out[33 * 8];
+
+    Scanline()
+    {
+        std::mt19937 rng(0x6502);
+        for (int i = 0; i < 33; i++) {
+            low[i] = uint8_t(rng());
+            high[i] = uint8_t(rng());
+            attr[i] = uint8_t((rng() & 0x03) << 2);
+        }
+    }
+};
+
+void decode(benchmark::State &state, ppu::DecodeRows decoder)
+{
+    Scanline line;
+    for (auto _ : state) {
+        decoder(line.low, line.high, line.attr, 33, line.out);
+        benchmark::DoNotOptimize(line.out);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * 33);
+    state.SetBytesProcessed(state.iterations() * sizeof(line.out));
+}
+
+void BM_DecodeScalar(benchmark::State &state) { decode(state, ppu::decode_rows_scalar); }
+void BM_DecodeLut(benchmark::State &state) { decode(state, ppu::decode_rows_lut); }
+BENCHMARK(BM_DecodeScalar);
+BENCHMARK(BM_DecodeLut);
+
+#if NES_TILE_X86
+void BM_DecodeSse2(benchmark::State &state) { decode(state, ppu::decode_rows_sse2); }
+BENCHMARK(BM_DecodeSse2);
+
+void BM_DecodeAvx2(benchmark::State &state)
+{
+    if (!ppu::avx2_supported()) {
+        state.SkipWithError("AVX2 not supported");
+        return;
+    }
+    decode(state, ppu::decode_rows_avx2);
+}
+BENCHMARK(BM_DecodeAvx2);
+#endif
+
+}   // Anonymous namespace.
@@ -0,0 +1,487 @@
+// apu.cpp
+//
+#include "apu/apu.h"
+#include "cpu/cpu.h"
+#include "cpu/interrupts.h"
+
+#include <algorithm>
+
+namespace apu {
+
+namespace {
+
+// Linear approximation of the mixer, output units per step of each channel.
+// Everything at full volume stays below 28000.
+constexpr int32_t PULSE_WEIGHT    = 246;
+constexpr int32_t TRIANGLE_WEIGHT = 279;
+constexpr int32_t NOISE_WEIGHT    = 162;
+constexpr int32_t DMC_WEIGHT      = 110;
+
+// CPU cycles a DMC fetch takes the bus for.
+constexpr uint32_t DMC_STALL = 4;
+
+/// Runs a timer with timer cycles left and given reload period for elapsed
+/// cycles. Returns how many times it fired, timer is left at the cycles to
+/// its next firing.
+inline uint64_t advance(uint32_t &timer, uint32_t period, uint64_t elapsed)
+{
+    if (timer > elapsed) {
+        timer -= uint32_t(elapsed);
+        return 0;
+    }
+    elapsed -= timer;
+    timer = uint32_t(period - elapsed % period);
+    return 1 + elapsed / period;
+}
+
+}   // Anonymous namespace.
+
+APU::APU(bus::Bus &bus)
+{
+    pulse[0] = {};
+    pulse[1] = {};
+    pulse[0].ones_complement = true;
+    triangle = {};
+    noise = {};
+    dmc = {};
+    for (auto &p : pulse) {
+        p.timer = p.timer_period();
+    }
+    triangle.timer = triangle.timer_period();
+    noise.lfsr = 0x0001;
+    noise.timer = noise.timer_period();
+    dmc.sample_addr   = 0xc000;
+    dmc.sample_length = 1;
+    dmc.bits          = 8;
+    dmc.silence       = true;
+    dmc.timer         = dmc.timer_period();
+    enabled           = 0x00;
+
+    five_step   = false;
+    irq_inhibit = false;
+    frame_irq   = false;
+    frame_start = 0;
+    frame_step  = 0;
+
+    this->bus  = &bus;
+    cpu        = nullptr;
+    interrupts = nullptr;
+    cpu_cycle  = 0;
+
+    sample_rate  = 0;
+    output       = true;
+    mix_cycle    = 0;
+    pulse_amp[0] = pulse_amp[1] = 0;
+    triangle_amp = 0;
+    noise_amp    = 0;
+    dmc_amp      = 0;
+    event_cycle = find_next_event();
+}
+
+uint8_t APU::read_status()
+{
+    catch_up();
+    uint8_t val = 0x00;
+    val |= (pulse[0].length != 0) ? 0x01 : 0x00;
+    val |= (pulse[1].length != 0) ? 0x02 : 0x00;
+    val |= (triangle.length != 0) ? 0x04 : 0x00;
+    val |= (noise.length != 0)    ? 0x08 : 0x00;
+    val |= (dmc.remaining != 0)   ? 0x10 : 0x00;
+    val |= frame_irq              ? 0x40 : 0x00;
+    val |= dmc.irq                ? 0x80 : 0x00;
+    frame_irq = false;
+    update_irq();
+    return val;
+}
+
+void APU::write(uint16_t addr, uint8_t val)
+{
+    catch_up();
+    const int reg = addr & 0x03;
+    if (addr < 0x4004) {
+        pulse[0].write(reg, val, enabled & 0x01);
+    } else if (addr < 0x4008) {
+        pulse[1].write(reg, val, enabled & 0x02);
+    } else if (addr < 0x400c) {
+        triangle.write(reg, val, enabled & 0x04);
+    } else if (addr < 0x4010) {
+        noise.write(reg, val, enabled & 0x08);
+    } else if (addr < 0x4014) {
+        dmc.write(reg, val);
+        update_irq();
+    } else if (addr == 0x4015) {
+        enabled = val & 0x1f;
+        if (!(val & 0x01)) {
+            pulse[0].length = 0;
+        }
+        if (!(val & 0x02)) {
+            pulse[1].length = 0;
+        }
+        if (!(val & 0x04)) {
+            triangle.length = 0;
+        }
+        if (!(val & 0x08)) {
+            noise.length = 0;
+        }
+        if (!(val & 0x10)) {
+            dmc.remaining = 0;
+        } else if (dmc.remaining == 0) {
+            dmc.restart();
+            fetch_dmc();
+        }
+        dmc.irq = false;
+        update_irq();
+    } else if (addr == 0x4017) {
+        five_step = val & 0x80;
+        irq_inhibit = val & 0x40;
+        if (irq_inhibit) {
+            frame_irq = false;
+            update_irq();
+        }
+        // The sequencer restarts 3 or 4 cycles later, depending on where in
+        // an APU cycle (2 CPU cycles) the write lands. The 5 step mode
+        // clocks everything right away.
+        frame_start = cpu_cycle + 3 + (cpu_cycle & 1);
+        frame_step = 0;
+        if (five_step) {
+            clock_quarter_frame();
+            clock_half_frame();
+        }
+    }
+    if (mixing()) {
+        update_levels();
+    }
+    event_cycle = find_next_event();
+}
+
+void APU::reset()
+{
+    write(0x4015, 0x00);
+    write(0x4017, uint8_t((five_step ? 0x80 : 0x00) | (irq_inhibit ? 0x40 : 0x00)));
+    frame_irq = false;
+    update_irq();
+}
+
+void APU::run_until(uint64_t cycle)
+{
+    while (cpu_cycle < cycle) {
+        // Blip frames are kept short even if nobody calls end_frame().
+        const uint64_t step = frame_step_cycle();
+        uint64_t next = std::min(cycle, step);
+        if (mixing()) {
+            next = std::min(next, mix_cycle + MIX_SPAN);
+        }
+        run_channels(cpu_cycle, next);
+        cpu_cycle = next;
+        if (cpu_cycle == step) {
+            step_frame();
+        }
+        if (mixing() && cpu_cycle == mix_cycle + MIX_SPAN) {
+            mix();
+        }
+    }
+    event_cycle = find_next_event();
+}
+
+void APU::catch_up()
+{
+    if (cpu != nullptr) {
+        run_until(cpu->bus_cycle());
+    }
+}
+
+uint64_t APU::find_next_event() const
+{
+    uint64_t next = frame_step_cycle();
+    if (dmc.remaining != 0) {
+        // The next fetch comes when the shift register runs out of bits.
+        next = std::min(next, cpu_cycle + dmc.timer + uint64_t(dmc.bits - 1) * dmc.timer_period());
+    }
+    if (mixing()) {
+        next = std::min(next, mix_cycle + MIX_SPAN);
+    }
+    return next;
+}
+
+void APU::step_frame()
+{
+    if (five_step) {
+        // Step 4 of 5 does nothing.
+        if (frame_step != 3) {
+            clock_quarter_frame();
+        }
+        if (frame_step == 1 || frame_step == 4) {
+            clock_half_frame();
+        }
+    } else {
+        clock_quarter_frame();
+        if (frame_step == 1 || frame_step == 3) {
+            clock_half_frame();
+        }
+        if (frame_step == 3 && !irq_inhibit) {
+            frame_irq = true;
+            update_irq();
+        }
+    }
+
+    frame_step++;
+    if (frame_step == (five_step ? 5 : 4)) {
+        frame_start += five_step ? SEQUENCE_5 : SEQUENCE_4;
+        frame_step = 0;
+    }
+    if (mixing()) {
+        update_levels();
+    }
+}
+
+void APU::clock_quarter_frame()
+{
+    pulse[0].envelope.clock();
+    pulse[1].envelope.clock();
+    noise.envelope.clock();
+    triangle.clock_quarter();
+}
+
+void APU::clock_half_frame()
+{
+    pulse[0].clock_half();
+    pulse[1].clock_half();
+    triangle.clock_half();
+    noise.clock_half();
+}
+
+void APU::update_irq()
+{
+    if (interrupts != nullptr) {
+        interrupts->set_irq(cpu::IrqSource::ApuFrame, frame_irq);
+        interrupts->set_irq(cpu::IrqSource::ApuDmc, dmc.irq);
+    }
+}
+
+void APU::run_channels(uint64_t from, uint64_t to)
+{
+    if (to <= from) {
+        return;
+    }
+    run_pulse(0, from, to);
+    run_pulse(1, from, to);
+    run_triangle(from, to);
+    run_noise(from, to);
+    run_dmc(from, to);
+}
+
+void APU::run_pulse(int index, uint64_t from, uint64_t to)
+{
+    Pulse &p = pulse[index];
+    const uint32_t period = p.timer_period();
+    const uint64_t first = from + p.timer;
+    const uint64_t steps = advance(p.timer, period, to - from);
+    if (steps == 0) {
+        return;
+    }
+    if (!mixing() || !p.audible()) {
+        p.step = uint8_t((p.step + steps) & 0x07);
+        return;
+    }
+    for (uint64_t i = 0; i < steps; i++) {
+        p.step = (p.step + 1) & 0x07;
+        emit(pulse_amp[index], PULSE_WEIGHT * p.output(), first + i * period);
+    }
+}
+
+void APU::run_triangle(uint64_t from, uint64_t to)
+{
+    const uint32_t period = triangle.timer_period();
+    const uint64_t first = from + triangle.timer;
+    const uint64_t steps = advance(triangle.timer, period, to - from);
+    if (steps == 0 || !triangle.active()) {
+        return;
+    }
+    if (!mixing()) {
+        triangle.step = uint8_t((triangle.step + steps) & 0x1f);
+        return;
+    }
+    for (uint64_t i = 0; i < steps; i++) {
+        triangle.step = (triangle.step + 1) & 0x1f;
+        emit(triangle_amp, TRIANGLE_WEIGHT * triangle.output(), first + i * period);
+    }
+}
+
+void APU::run_noise(uint64_t from, uint64_t to)
+{
+    const uint32_t period = noise.timer_period();
+    const uint64_t first = from + noise.timer;
+    const uint64_t steps = advance(noise.timer, period, to - from);
+    if (steps == 0) {
+        return;
+    }
+    if (!mixing() || !noise.audible()) {
+        noise.skip(steps);
+        return;
+    }
+    for (uint64_t i = 0; i < steps; i++) {
+        noise.shift();
+        emit(noise_amp, NOISE_WEIGHT * noise.output(), first + i * period);
+    }
+}
+
+void APU::run_dmc(uint64_t from, uint64_t to)
+{
+    const uint32_t period = dmc.timer_period();
+    uint64_t cycle = from + dmc.timer;
+    const uint64_t steps = advance(dmc.timer, period, to - from);
+    if (steps == 0) {
+        return;
+    }
+    if (dmc.idle()) {
+        // Only the bit counter keeps going round.
+        dmc.bits = uint8_t(1 + (dmc.bits - 1 + 8 - steps % 8) % 8);
+        return;
+    }
+    for (uint64_t i = 0; i < steps; i++, cycle += period) {
+        if (!dmc.silence) {
+            if (dmc.shift & 0x01) {
+                if (dmc.level <= 125) {
+                    dmc.level += 2;
+                }
+            } else if (dmc.level >= 2) {
+                dmc.level -= 2;
+            }
+            dmc.shift >>= 1;
+            if (mixing()) {
+                emit(dmc_amp, DMC_WEIGHT * dmc.level, cycle);
+            }
+        }
+        if (--dmc.bits == 0) {
+            dmc.bits = 8;
+            dmc.silence = !dmc.buffer_full;
+            if (dmc.buffer_full) {
+                dmc.shift = dmc.buffer;
+                dmc.buffer_full = false;
+                fetch_dmc();
+            }
+        }
+    }
+}
+
+void APU::fetch_dmc()
+{
+    if (dmc.buffer_full || dmc.remaining == 0) {
+        return;
+    }
+    dmc.buffer = bus->read(dmc.addr);
+    dmc.buffer_full = true;
+    dmc.addr = (dmc.addr == 0xffff) ? 0x8000 : uint16_t(dmc.addr + 1);
+    dmc.remaining--;
+    // The CPU waits while the DMC has the bus.
+    if (cpu != nullptr) {
+        cpu->stall(DMC_STALL);
+    }
+    if (dmc.remaining == 0) {
+        if (dmc.control & 0x40) {
+            dmc.restart();
+        } else if (dmc.control & 0x80) {
+            dmc.irq = true;
+            update_irq();
+        }
+    }
+}
+
+void APU::set_sample_rate(int rate)
+{
+    sample_rate = std::max(rate, 0);
+    if (sample_rate != 0) {
+        blip.set_rates(CLOCK_RATE, sample_rate);
+    }
+    mix_cycle = cpu_cycle;
+    pulse_amp[0] = pulse_amp[1] = 0;
+    triangle_amp = noise_amp = dmc_amp = 0;
+    if (mixing()) {
+        update_levels();
+    }
+    event_cycle = find_next_event();
+}
+
+void APU::set_output(bool enabled)
+{
+    if (enabled == output) {
+        return;
+    }
+    if (mixing()) {
+        mix();
+    }
+    output = enabled;
+    mix_cycle = cpu_cycle;
+    // Whatever changed while nobody listened comes in as one step.
+    if (mixing()) {
+        update_levels();
+    }
+    event_cycle = find_next_event();
+}
+
+void APU::end_frame()
+{
+    catch_up();
+    if (mixing()) {
+        mix();
+        event_cycle = find_next_event();
+    }
+}
+
+void APU::update_levels()
+{
+    emit(pulse_amp[0], PULSE_WEIGHT * pulse[0].output(), cpu_cycle);
+    emit(pulse_amp[1], PULSE_WEIGHT * pulse[1].output(), cpu_cycle);
+    emit(triangle_amp, TRIANGLE_WEIGHT * triangle.output(), cpu_cycle);
+    emit(noise_amp, NOISE_WEIGHT * noise.output(), cpu_cycle);
+    emit(dmc_amp, DMC_WEIGHT * dmc.level, cpu_cycle);
+}
+
+void APU::mix()
+{
+    blip.end_frame(uint32_t(cpu_cycle - mix_cycle));
+    mix_cycle = cpu_cycle;
+}
+
+void APU::save_state(state::Writer &state) const
+{
+    state.value(pulse[0]);
+    state.value(pulse[1]);
+    state.value(triangle);
+    state.value(noise);
+    state.value(dmc);
+    state.value(enabled);
+    state.value(five_step);
+    state.value(irq_inhibit);
+    state.value(frame_irq);
+    state.value(frame_start);
+    state.value(frame_step);
+    state.value(cpu_cycle);
+}
+
+void APU::load_state(state::Reader &state)
+{
+    // Sound so far belongs to the old timeline, finish it.
+    if (mixing()) {
+        mix();
+    }
+    state.value(pulse[0]);
+    state.value(pulse[1]);
+    state.value(triangle);
+    state.value(noise);
+    state.value(dmc);
+    state.value(enabled);
+    state.value(five_step);
+    state.value(irq_inhibit);
+    state.value(frame_irq);
+    state.value(frame_start);
+    state.value(frame_step);
+    state.value(cpu_cycle);
+    mix_cycle = cpu_cycle;
+    if (mixing()) {
+        update_levels();
+    }
+    event_cycle = find_next_event();
+}
+
+}   // Namespace apu.
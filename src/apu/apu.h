@@ -0,0 +1,172 @@
+// apu.h : Audio processing unit. Two pulse channels, a triangle, noise and
+// delta modulation, the frame sequencer with its IRQ, and the mix of all of
+// them as host rate samples.
+//
+#pragma once
+
+#include "apu/blip.h"
+#include "apu/channels.h"
+#include "bus.h"
+#include "state.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cpu {
+class CPU;
+class Interrupts;
+}
+
+namespace apu {
+
+/// NTSC CPU clock, which also clocks the APU.
+static constexpr double CLOCK_RATE = 1789772.727;
+
+/// The APU half of $4000-$4017, io::Registers forwards to it.
+///
+/// Like the PPU it lags behind the CPU and is only run when the CPU could
+/// tell: a register access first catches it up, and whoever drives the CPU
+/// runs it at next_event() for the frame sequencer, DMC fetches and to hand
+/// out sound. Channel timers advance a whole timer period at a time, and only
+/// while a channel can be heard does every step produce a level change for
+/// the band-limited synthesis.
+class APU {
+public:
+    /// DMC samples are fetched through bus.
+    explicit APU(bus::Bus &bus);
+    APU(const APU&) = delete;
+    APU &operator=(const APU&) = delete;
+
+    /// $4015 read: length counters, DMC, frame and DMC IRQ flags. Clears the
+    /// frame IRQ.
+    uint8_t read_status();
+    /// Write to $4000-$4013, $4015 or $4017.
+    void write(uint16_t addr, uint8_t val);
+
+    /// CPU to catch up to before register accesses, that DMC fetches stall.
+    /// May be nullptr to run the APU only by hand.
+    inline void set_cpu(cpu::CPU *cpu) { this->cpu = cpu; }
+    /// Interrupt lines the frame and DMC IRQs go to, may be nullptr.
+    inline void set_interrupts(cpu::Interrupts *interrupts) { this->interrupts = interrupts; }
+
+    /// The reset button: silences every channel and restarts the frame
+    /// sequencer in its current mode.
+    void reset();
+
+    /// Runs the APU up to CPU cycle cycle. Does nothing if it is there
+    /// already.
+    void run_until(uint64_t cycle);
+    /// CPU cycle the APU has been run up to.
+    inline uint64_t clock() const { return cpu_cycle; }
+    /// First CPU cycle at which the APU does something the CPU could notice
+    /// (a frame sequencer step, a DMC fetch) or has sound to hand out.
+    inline uint64_t next_event() const { return event_cycle; }
+
+    /// Samples per second to mix, 0 (the default) for no sound at all. The
+    /// channels still run, the CPU sees no difference.
+    void set_sample_rate(int rate);
+    /// Turns mixing on or off without losing the sample rate, for frames
+    /// nobody listens to. Turning it back on continues without a gap.
+    void set_output(bool enabled);
+    /// Runs up to the CPU's cycle and makes all sound so far readable.
+    void end_frame();
+    /// Samples ready to be read, mono 16 bit.
+    inline size_t samples_available() const { return blip.available(); }
+    /// Moves up to count samples into out, returns how many.
+    inline size_t read_samples(int16_t *out, size_t count) { return blip.read(out, count); }
+
+    /// Appends channels, frame sequencer and timing to state. What was mixed
+    /// but not read yet is left out, like the PPU's framebuffer.
+    void save_state(state::Writer &state) const;
+    /// Reads back what save_state() wrote.
+    void load_state(state::Reader &state);
+
+private:
+    // Steps of the frame sequencer in CPU cycles after it starts, for the
+    // 4 and 5 step modes, and the length of one sequence.
+    static constexpr uint32_t STEPS_4[4] = { 7457, 14913, 22371, 29829 };
+    static constexpr uint32_t STEPS_5[5] = { 7457, 14913, 22371, 29829, 37281 };
+    static constexpr uint32_t SEQUENCE_4 = 29830;
+    static constexpr uint32_t SEQUENCE_5 = 37282;
+    // Sound is handed to blip at least this often, about 1/30 s.
+    static constexpr uint32_t MIX_SPAN = 59659;
+
+    /// Runs up to the CPU's current bus access, if there is a CPU.
+    void catch_up();
+    /// Works out next_event() from the current position.
+    uint64_t find_next_event() const;
+    /// CPU cycle of the next frame sequencer step.
+    inline uint64_t frame_step_cycle() const
+    {
+        return frame_start + (five_step ? STEPS_5[frame_step] : STEPS_4[frame_step]);
+    }
+    /// Clocks envelopes, counters and sweeps for the step due at cpu_cycle.
+    void step_frame();
+    /// Envelopes and the triangle's linear counter.
+    void clock_quarter_frame();
+    /// Length counters and sweeps.
+    void clock_half_frame();
+    /// Drives the IRQ line sources.
+    void update_irq();
+
+    /// Runs the channel timers over (from, to].
+    void run_channels(uint64_t from, uint64_t to);
+    void run_pulse(int index, uint64_t from, uint64_t to);
+    void run_triangle(uint64_t from, uint64_t to);
+    void run_noise(uint64_t from, uint64_t to);
+    void run_dmc(uint64_t from, uint64_t to);
+    /// Fills the empty DMC buffer with the next sample byte, if any is left.
+    void fetch_dmc();
+
+    /// True while the channels' output goes into blip.
+    inline bool mixing() const { return sample_rate != 0 && output; }
+    /// Puts a level change of a channel into blip at cycle. Only while
+    /// mixing().
+    inline void emit(int32_t &amp, int32_t level, uint64_t cycle)
+    {
+        if (level != amp) {
+            blip.add_delta(uint32_t(cycle - mix_cycle), level - amp);
+            amp = level;
+        }
+    }
+    /// Emits every channel's current level at cpu_cycle, after registers or
+    /// the frame sequencer changed them.
+    void update_levels();
+    /// Ends the blip frame at cpu_cycle.
+    void mix();
+
+    Pulse pulse[2];
+    Triangle triangle;
+    Noise noise;
+    Dmc dmc;
+    // $4015 channel enables, DMC's is its remaining count.
+    uint8_t enabled;
+
+    bool five_step;
+    bool irq_inhibit;
+    bool frame_irq;
+    // Cycle the current sequence started, may be a few cycles ahead after a
+    // $4017 write, and the next step in it.
+    uint64_t frame_start;
+    int frame_step;
+
+    bus::Bus *bus;
+    cpu::CPU *cpu;
+    cpu::Interrupts *interrupts;
+    uint64_t cpu_cycle;
+    uint64_t event_cycle;
+
+    // Mixing. Not part of the state, like the framebuffer. amps are the
+    // levels last put into blip, mix_cycle is where its current frame
+    // started.
+    Blip blip;
+    int sample_rate;
+    bool output;
+    uint64_t mix_cycle;
+    int32_t pulse_amp[2];
+    int32_t triangle_amp;
+    int32_t noise_amp;
+    int32_t dmc_amp;
+};
+
+}   // Namespace apu.
@@ -0,0 +1,134 @@
+// blip.cpp
+//
+#include "apu/blip.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace apu {
+
+int16_t Blip::KERNEL[PHASES][WIDTH];
+const bool Blip::KERNEL_READY = Blip::fill_kernel();
+
+bool Blip::fill_kernel()
+{
+    constexpr double PI = 3.14159265358979323846;
+    constexpr int HALF = WIDTH / 2;
+    // Cut off a little below Nyquist, the window needs the room.
+    constexpr double CUTOFF = 0.9;
+    constexpr int SUBSTEPS = 32;
+    constexpr double UNIT = 1 << KERNEL_BITS;
+
+    // Blackman windowed sinc, u in samples.
+    const auto impulse = [=](double u) {
+        if (std::fabs(u) >= HALF) {
+            return 0.0;
+        }
+        const double x = PI * CUTOFF * u;
+        const double sinc = (x == 0.0) ? 1.0 : std::sin(x) / x;
+        const double w = u / HALF;
+        return sinc * (0.42 + 0.5 * std::cos(PI * w) + 0.08 * std::cos(2.0 * PI * w));
+    };
+
+    for (int phase = 0; phase < PHASES; phase++) {
+        // Tap i gets the part of the step that rises between output samples
+        // i - 1 and i, the step itself being HALF - 1 samples in plus the
+        // phase. The output is that much late.
+        const double frac = double(phase) / PHASES;
+        double taps[WIDTH];
+        double total = 0.0;
+        for (int i = 0; i < WIDTH; i++) {
+            const double start = i - HALF - frac;
+            double area = 0.0;
+            for (int s = 0; s < SUBSTEPS; s++) {
+                area += impulse(start + (s + 0.5) / SUBSTEPS);
+            }
+            taps[i] = area;
+            total += area;
+        }
+
+        // Rounding mustn't leave DC behind, the largest tap takes the
+        // difference.
+        int16_t *kernel = KERNEL[phase];
+        int sum = 0;
+        int largest = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            kernel[i] = int16_t(std::lround(taps[i] * UNIT / total));
+            sum += kernel[i];
+            if (kernel[i] > kernel[largest]) {
+                largest = i;
+            }
+        }
+        kernel[largest] = int16_t(kernel[largest] + int(UNIT) - sum);
+    }
+    return true;
+}
+
+Blip::Blip()
+    : capacity(0), avail(0), factor(0), offset(0), max_clocks(0), integrator(0)
+{
+}
+
+void Blip::set_rates(double clock_rate, double sample_rate)
+{
+    capacity = size_t(sample_rate / 8) + 1;
+    // The current frame's samples go after the unread ones.
+    buf.assign(capacity * 2 + WIDTH + 1, 0);
+    factor = uint64_t(std::llround(sample_rate / clock_rate * double(uint64_t(1) << FRAC_BITS)));
+    max_clocks = uint32_t(double(capacity) * clock_rate / sample_rate);
+    clear();
+}
+
+void Blip::clear()
+{
+    std::fill(buf.begin(), buf.end(), 0);
+    avail = 0;
+    offset = 0;
+    integrator = 0;
+}
+
+void Blip::end_frame(uint32_t duration)
+{
+    offset += uint64_t(duration) * factor;
+    const size_t count = size_t(offset >> FRAC_BITS);
+    offset &= (uint64_t(1) << FRAC_BITS) - 1;
+    if (avail + count > capacity) {
+        // Nobody is reading. The dropped samples still count towards the
+        // level so the rest continues smoothly.
+        read(nullptr, avail + count - capacity);
+    }
+    avail += count;
+}
+
+size_t Blip::read(int16_t *out, size_t count)
+{
+    count = std::min(count, avail);
+    int32_t sum = integrator;
+    for (size_t i = 0; i < count; i++) {
+        sum += buf[i];
+        const int32_t sample = std::clamp(sum >> KERNEL_BITS, int32_t(-32768), int32_t(32767));
+        if (out != nullptr) {
+            out[i] = int16_t(sample);
+        }
+        // Leaking a little of the level each sample is the high-pass.
+        sum -= sample * (1 << (KERNEL_BITS - BASS_SHIFT));
+    }
+    integrator = sum;
+    remove(count);
+    return count;
+}
+
+void Blip::remove(size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    // Unread samples, whatever the current frame wrote and the zeroed rest
+    // all move down.
+    std::memmove(buf.data(), buf.data() + count, (buf.size() - count) * sizeof(int32_t));
+    std::fill(buf.end() - ptrdiff_t(count), buf.end(), 0);
+    avail -= std::min(count, avail);
+}
+
+}   // Namespace apu.
@@ -0,0 +1,86 @@
+// blip.h : Band-limited step synthesis. A signal described by the steps it
+// takes at clock times is turned into samples at the host rate by adding a
+// windowed-sinc step per change. The cost follows the number of changes, not
+// the clock rate, and nothing above the output's Nyquist frequency aliases.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace apu {
+
+class Blip {
+public:
+    Blip();
+    Blip(const Blip&) = delete;
+    Blip &operator=(const Blip&) = delete;
+
+    /// Clocks per second of the times given to add_delta() and samples per
+    /// second out. Makes room for 1/8 s of samples and clears the buffer.
+    void set_rates(double clock_rate, double sample_rate);
+    /// Drops all samples and steps, the signal starts over at 0.
+    void clear();
+
+    /// Steps the signal by delta at time clocks after the start of the
+    /// current frame. time must be below max_frame().
+    inline void add_delta(uint32_t time, int32_t delta)
+    {
+        const uint64_t fixed = uint64_t(time) * factor + offset;
+        int32_t *out = &buf[avail + size_t(fixed >> FRAC_BITS)];
+        const int16_t *kernel = KERNEL[(fixed >> (FRAC_BITS - PHASE_BITS)) & (PHASES - 1)];
+        for (int i = 0; i < WIDTH; i++) {
+            out[i] += kernel[i] * delta;
+        }
+    }
+    /// Ends the current frame duration clocks in. Samples up to there can be
+    /// read and the next frame starts where this one ended. If unread samples
+    /// overflow the buffer the oldest are dropped.
+    void end_frame(uint32_t duration);
+    /// Longest frame in clocks.
+    inline uint32_t max_frame() const { return max_clocks; }
+
+    /// Samples ready to be read.
+    inline size_t available() const { return avail; }
+    /// Moves up to count samples into out, returns how many. out may be
+    /// nullptr to skip them.
+    size_t read(int16_t *out, size_t count);
+
+    // Taps per step and phases (fractions of a sample) they are tabled for.
+    static constexpr int WIDTH = 16;
+    static constexpr int PHASE_BITS = 6;
+    static constexpr int PHASES = 1 << PHASE_BITS;
+
+private:
+    // Sample positions are 32.32 fixed point.
+    static constexpr int FRAC_BITS = 32;
+    // Every kernel row sums to 1 << KERNEL_BITS, one unit of delta.
+    static constexpr int KERNEL_BITS = 14;
+    // High-pass filter removing DC, cutting off around 15 Hz at 48 kHz.
+    static constexpr int BASS_SHIFT = 9;
+
+    // Step differences for each phase, filled in by fill_kernel() at
+    // startup.
+    static int16_t KERNEL[PHASES][WIDTH];
+    static const bool KERNEL_READY;
+    static bool fill_kernel();
+
+    /// Drops count samples from the front.
+    void remove(size_t count);
+
+    // Accumulated step differences. The first avail entries are finished
+    // samples, after them come WIDTH taps of the current frame's steps.
+    std::vector<int32_t> buf;
+    size_t capacity;
+    size_t avail;
+    // Samples per clock, and where in the first unfinished sample the
+    // current frame starts, both fixed point.
+    uint64_t factor;
+    uint64_t offset;
+    uint32_t max_clocks;
+    // Running sum of buf, the signal level, scaled by 1 << KERNEL_BITS.
+    int32_t integrator;
+};
+
+}   // Namespace apu.
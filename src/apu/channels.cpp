@@ -0,0 +1,249 @@
+// channels.cpp
+//
+#include "apu/channels.h"
+
+namespace apu {
+
+const uint8_t LENGTH_TABLE[32] = {
+    10, 254, 20,  2, 40,  4, 80,  6, 160,  8, 60, 10, 14, 12, 26, 14,
+    12,  16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30,
+};
+
+namespace {
+
+constexpr uint8_t DUTY_TABLE[4][8] = {
+    {0, 1, 0, 0, 0, 0, 0, 0},   // 12.5%
+    {0, 1, 1, 0, 0, 0, 0, 0},   // 25%
+    {0, 1, 1, 1, 1, 0, 0, 0},   // 50%
+    {1, 0, 0, 1, 1, 1, 1, 1},   // 25% negated
+};
+
+constexpr uint8_t TRIANGLE_TABLE[32] = {
+    15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+};
+
+// NTSC timer periods in CPU cycles.
+constexpr uint16_t NOISE_PERIODS[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068,
+};
+constexpr uint16_t DMC_PERIODS[16] = {
+    428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54,
+};
+
+/// The LFSR shift is linear over GF(2), so 2^k shifts are a 15x15 bit matrix,
+/// stored as the image of each state bit. Any count of shifts is then a
+/// product of at most 64 of them.
+struct LfsrJumps {
+    uint16_t matrix[2][64][15];
+
+    static uint16_t apply(const uint16_t (&m)[15], uint16_t state)
+    {
+        uint16_t out = 0;
+        for (int bit = 0; state != 0; bit++, state >>= 1) {
+            if (state & 0x01) {
+                out ^= m[bit];
+            }
+        }
+        return out;
+    }
+
+    LfsrJumps()
+    {
+        for (int mode = 0; mode < 2; mode++) {
+            Noise noise = {};
+            noise.short_mode = (mode != 0);
+            for (int bit = 0; bit < 15; bit++) {
+                noise.lfsr = uint16_t(1 << bit);
+                noise.shift();
+                matrix[mode][0][bit] = noise.lfsr;
+            }
+            for (int k = 1; k < 64; k++) {
+                for (int bit = 0; bit < 15; bit++) {
+                    matrix[mode][k][bit] = apply(matrix[mode][k - 1], matrix[mode][k - 1][bit]);
+                }
+            }
+        }
+    }
+};
+
+const LfsrJumps lfsr_jumps;
+
+}   // Anonymous namespace.
+
+void Envelope::clock()
+{
+    if (start) {
+        start = false;
+        decay = 15;
+        divider = reg & 0x0f;
+    } else if (divider == 0) {
+        divider = reg & 0x0f;
+        if (decay != 0) {
+            decay--;
+        } else if (loop()) {
+            decay = 15;
+        }
+    } else {
+        divider--;
+    }
+}
+
+void Pulse::write(int reg, uint8_t val, bool enabled)
+{
+    switch (reg) {
+    case 0:
+        envelope.reg = val;
+        duty = val >> 6;
+        break;
+    case 1:
+        sweep = val;
+        sweep_reload = true;
+        break;
+    case 2:
+        period = uint16_t((period & 0x0700) | val);
+        break;
+    default:
+        period = uint16_t((period & 0x00ff) | ((val & 0x07) << 8));
+        if (enabled) {
+            length = LENGTH_TABLE[val >> 3];
+        }
+        step = 0;
+        envelope.start = true;
+        break;
+    }
+}
+
+uint16_t Pulse::sweep_target() const
+{
+    const int change = period >> (sweep & 0x07);
+    if (sweep & 0x08) {
+        const int target = period - change - (ones_complement ? 1 : 0);
+        return uint16_t(target < 0 ? 0 : target);
+    }
+    return uint16_t(period + change);
+}
+
+void Pulse::clock_half()
+{
+    if (sweep_divider == 0 && (sweep & 0x80) && (sweep & 0x07) && !muted()) {
+        period = sweep_target();
+    }
+    if (sweep_divider == 0 || sweep_reload) {
+        sweep_divider = (sweep >> 4) & 0x07;
+        sweep_reload = false;
+    } else {
+        sweep_divider--;
+    }
+
+    if (!envelope.loop() && length != 0) {
+        length--;
+    }
+}
+
+uint8_t Pulse::output() const
+{
+    return (length != 0 && !muted() && DUTY_TABLE[duty][step]) ? envelope.volume() : 0;
+}
+
+void Triangle::write(int reg, uint8_t val, bool enabled)
+{
+    switch (reg) {
+    case 0:
+        control = val;
+        break;
+    case 1:
+        break;
+    case 2:
+        period = uint16_t((period & 0x0700) | val);
+        break;
+    default:
+        period = uint16_t((period & 0x00ff) | ((val & 0x07) << 8));
+        if (enabled) {
+            length = LENGTH_TABLE[val >> 3];
+        }
+        linear_reload = true;
+        break;
+    }
+}
+
+void Triangle::clock_quarter()
+{
+    if (linear_reload) {
+        linear = control & 0x7f;
+    } else if (linear != 0) {
+        linear--;
+    }
+    if (!(control & 0x80)) {
+        linear_reload = false;
+    }
+}
+
+uint8_t Triangle::output() const
+{
+    return TRIANGLE_TABLE[step];
+}
+
+void Noise::write(int reg, uint8_t val, bool enabled)
+{
+    switch (reg) {
+    case 0:
+        envelope.reg = val;
+        break;
+    case 1:
+        break;
+    case 2:
+        short_mode = val & 0x80;
+        rate = val & 0x0f;
+        break;
+    default:
+        if (enabled) {
+            length = LENGTH_TABLE[val >> 3];
+        }
+        envelope.start = true;
+        break;
+    }
+}
+
+void Noise::skip(uint64_t count)
+{
+    const auto &jumps = lfsr_jumps.matrix[short_mode ? 1 : 0];
+    for (int k = 0; count != 0; k++, count >>= 1) {
+        if (count & 0x01) {
+            lfsr = LfsrJumps::apply(jumps[k], lfsr);
+        }
+    }
+}
+
+uint32_t Noise::timer_period() const
+{
+    return NOISE_PERIODS[rate];
+}
+
+void Dmc::write(int reg, uint8_t val)
+{
+    switch (reg) {
+    case 0:
+        control = val;
+        if (!(control & 0x80)) {
+            irq = false;
+        }
+        break;
+    case 1:
+        level = val & 0x7f;
+        break;
+    case 2:
+        sample_addr = uint16_t(0xc000 + val * 64);
+        break;
+    default:
+        sample_length = uint16_t(val * 16 + 1);
+        break;
+    }
+}
+
+uint32_t Dmc::timer_period() const
+{
+    return DMC_PERIODS[control & 0x0f];
+}
+
+}   // Namespace apu.
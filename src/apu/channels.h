@@ -0,0 +1,148 @@
+// channels.h : The APU's sound channels. Each one holds its registers and the
+// counters the frame sequencer clocks. Their timers are run by the APU, which
+// knows whether anyone is listening. Channels are plain data so save states
+// copy them whole.
+//
+#pragma once
+
+#include <cstdint>
+
+namespace apu {
+
+/// Length counter loads, indexed by the top 5 bits of the channel's last
+/// register.
+extern const uint8_t LENGTH_TABLE[32];
+
+/// Volume envelope of the pulse and noise channels.
+struct Envelope {
+    uint8_t reg;        // --LC VVVV: loop/halt, constant volume, volume/period.
+    bool start;
+    uint8_t divider;
+    uint8_t decay;
+
+    /// Quarter frame clock.
+    void clock();
+    inline uint8_t volume() const { return (reg & 0x10) ? (reg & 0x0f) : decay; }
+    /// Loops the envelope and halts the length counter.
+    inline bool loop() const { return reg & 0x20; }
+};
+
+/// Square wave with duty cycle, envelope and sweep ($4000-$4007).
+struct Pulse {
+    Envelope envelope;
+    uint8_t duty;
+    uint8_t sweep;      // EPPP NSSS: enable, period, negate, shift.
+    bool sweep_reload;
+    uint8_t sweep_divider;
+    uint16_t period;    // 11 bit timer reload.
+    uint8_t length;
+    uint8_t step;       // Position in the 8 step duty sequence.
+    uint32_t timer;     // CPU cycles until the next step.
+    // Pulse 1 negates sweeps with one's complement, pulse 2 with two's.
+    bool ones_complement;
+
+    /// Register reg (0-3) write. enabled is the channel's $4015 bit.
+    void write(int reg, uint8_t val, bool enabled);
+    /// Half frame clock of sweep and length counter.
+    void clock_half();
+
+    /// Period the sweep is heading for.
+    uint16_t sweep_target() const;
+    /// True if the period is out of range, whether the sweep is on or not.
+    inline bool muted() const { return period < 8 || sweep_target() > 0x7ff; }
+    /// True if steps can change the output.
+    inline bool audible() const { return length != 0 && !muted() && envelope.volume() != 0; }
+    uint8_t output() const;
+    inline uint32_t timer_period() const { return (uint32_t(period) + 1) * 2; }
+};
+
+/// Triangle wave with linear counter ($4008-$400B).
+struct Triangle {
+    uint8_t control;    // CRRR RRRR: halt/control flag, linear counter load.
+    uint16_t period;
+    uint8_t length;
+    uint8_t linear;
+    bool linear_reload;
+    uint8_t step;       // Position in the 32 step sequence.
+    uint32_t timer;
+
+    void write(int reg, uint8_t val, bool enabled);
+    /// Quarter frame clock of the linear counter.
+    void clock_quarter();
+    /// Half frame clock of the length counter.
+    inline void clock_half()
+    {
+        if (!(control & 0x80) && length != 0) {
+            length--;
+        }
+    }
+
+    /// True if the sequencer steps. Periods below 2 would be ultrasonic,
+    /// those hold the output like a halted channel rather than spend a
+    /// step every CPU cycle.
+    inline bool active() const { return length != 0 && linear != 0 && period >= 2; }
+    uint8_t output() const;
+    inline uint32_t timer_period() const { return uint32_t(period) + 1; }
+};
+
+/// Pseudo-random noise from a 15 bit LFSR ($400C-$400F).
+struct Noise {
+    Envelope envelope;
+    bool short_mode;    // Taps bit 6 instead of 1, for a 93 step sequence.
+    uint8_t rate;       // Index into the period table.
+    uint8_t length;
+    uint16_t lfsr;
+    uint32_t timer;
+
+    void write(int reg, uint8_t val, bool enabled);
+    inline void clock_half()
+    {
+        if (!envelope.loop() && length != 0) {
+            length--;
+        }
+    }
+    /// Shifts the LFSR once.
+    inline void shift()
+    {
+        const uint16_t feedback = (lfsr ^ (lfsr >> (short_mode ? 6 : 1))) & 0x01;
+        lfsr = uint16_t((lfsr >> 1) | (feedback << 14));
+    }
+    /// Same as count shift()s, in a few dozen operations.
+    void skip(uint64_t count);
+
+    inline bool audible() const { return length != 0 && envelope.volume() != 0; }
+    inline uint8_t output() const { return (length != 0 && !(lfsr & 0x01)) ? envelope.volume() : 0; }
+    uint32_t timer_period() const;
+};
+
+/// Delta modulation sample playback ($4010-$4013). Sample bytes are fetched
+/// by the APU, which owns the bus.
+struct Dmc {
+    uint8_t control;    // IL-- RRRR: IRQ enable, loop, rate.
+    uint8_t level;      // 7 bit output.
+    uint16_t sample_addr;
+    uint16_t sample_length;
+    uint16_t addr;      // Next byte to fetch.
+    uint16_t remaining; // Bytes left to fetch.
+    uint8_t buffer;
+    bool buffer_full;
+    uint8_t shift;
+    uint8_t bits;       // Bits left in shift, 1-8.
+    bool silence;
+    bool irq;
+    uint32_t timer;
+
+    /// Register reg (0-3) write.
+    void write(int reg, uint8_t val);
+    /// Starts the sample over.
+    inline void restart()
+    {
+        addr = sample_addr;
+        remaining = sample_length;
+    }
+    /// True if clocks neither change the level nor need a fetch.
+    inline bool idle() const { return silence && !buffer_full && remaining == 0; }
+    uint32_t timer_period() const;
+};
+
+}   // Namespace apu.
@@ -0,0 +1,267 @@
+// main.cpp : Headless batch runner. Runs every ROM of a list on its own
+// Console on a thread pool and prints a line of results per ROM.
+//
+#include "console.h"
+#include "nes-error.h"
+#include "profile.h"
+#include "thread-pool.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// How long to run a ROM. Stops at whichever limit comes first, 0 means no
+/// limit.
+struct Budget {
+    uint64_t frames = 0;
+    uint64_t cycles = 0;
+};
+
+struct Job {
+    std::string path;
+    Budget budget;
+    // Profile output files start with this, empty to not profile.
+    std::string profile;
+    bool block_cache = false;
+};
+
+struct Result {
+    NesError status = NesError::Success;
+    uint64_t frames = 0;
+    uint64_t cycles = 0;
+    uint64_t hash = 0;
+    double seconds = 0.0;
+};
+
+/// FNV-1a of the last frame and the internal RAM.
+uint64_t hash(const Console &console)
+{
+    uint64_t h = 0xcbf29ce484222325;
+    const auto add = [&h](const uint8_t *data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            h = (h ^ data[i]) * 0x100000001b3;
+        }
+    };
+    add(console.ppu().frame(), ppu::SCREEN_WIDTH * ppu::SCREEN_HEIGHT);
+    add(console.ram(), Console::RAM_SIZE);
+    return h;
+}
+
+NesError run(Console &console, const Budget &budget)
+{
+    for (;;) {
+        if (budget.frames != 0 && console.ppu().frame_count() >= budget.frames) {
+            return NesError::Success;
+        }
+        if (budget.cycles != 0 && console.cpu().cycles() >= budget.cycles) {
+            return NesError::Success;
+        }
+        const NesError err = console.step();
+        if (err != NesError::Success) {
+            return err;
+        }
+    }
+}
+
+Result run_job(const Job &job)
+{
+    Result result;
+    const auto start = std::chrono::steady_clock::now();
+
+    auto console = std::make_unique<Console>();
+    std::unique_ptr<profile::Profile> prof;
+    result.status = console->load(job.path);
+    if (result.status == NesError::Success) {
+        console->cpu().set_block_cache(job.block_cache);
+        if (!job.profile.empty()) {
+            prof = std::make_unique<profile::Profile>();
+            console->set_profile(prof.get());
+        }
+        result.status = run(*console, job.budget);
+        result.frames = console->ppu().frame_count();
+        result.cycles = console->cpu().cycles();
+        result.hash = hash(*console);
+    }
+    if (prof != nullptr) {
+        prof->write_json(job.profile + ".json");
+        prof->write_csv(job.profile + "-");
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    return result;
+}
+
+const char *error_name(NesError err)
+{
+    switch (err) {
+    case NesError::Success:             return "ok";
+    case NesError::CouldNotOpenFile:    return "could not open file";
+    case NesError::InvalidOpcode:       return "invalid opcode";
+    case NesError::InvalidRom:          return "invalid rom";
+    case NesError::UnsupportedMapper:   return "unsupported mapper";
+    default:                            return "error";
+    }
+}
+
+/// Parses trailing "frames=N" and "cycles=N" tokens off a list line, the
+/// rest of the line is the path.
+bool parse_job(const std::string &line, const Budget &defaults, Job &job)
+{
+    job.budget = defaults;
+    std::string rest = line;
+    for (;;) {
+        const size_t end = rest.find_last_not_of(" \t\r");
+        if (end == std::string::npos) {
+            return false;
+        }
+        rest.erase(end + 1);
+        const size_t space = rest.find_last_of(" \t");
+        const std::string token = rest.substr(space == std::string::npos ? 0 : space + 1);
+        uint64_t *field = nullptr;
+        if (token.rfind("frames=", 0) == 0) {
+            field = &job.budget.frames;
+        } else if (token.rfind("cycles=", 0) == 0) {
+            field = &job.budget.cycles;
+        } else {
+            break;
+        }
+        *field = std::strtoull(token.c_str() + 7, nullptr, 10);
+        rest.erase(space == std::string::npos ? 0 : space);
+    }
+    job.path = rest;
+    return !job.path.empty();
+}
+
+void usage()
+{
+    fmt::print(stderr,
+        "usage: nes-batch [-j threads] [-f frames] [-c cycles] [-b] [-p dir] [-l list] [rom...]\n"
+        "\n"
+        "Runs each ROM headless until it reaches its frame or cycle budget\n"
+        "(default 600 frames). List files have one ROM per line, optionally\n"
+        "followed by frames=N and/or cycles=N. Lines starting with # are\n"
+        "ignored.\n"
+        "\n"
+        "-b runs the CPU from its block cache.\n"
+        "-p writes a profile of each ROM to dir, <rom>-<n>.json and\n"
+        "<rom>-<n>-*.csv where n counts the ROMs from 0, so a ROM listed twice\n"
+        "gets two profiles. Needs a build with NES_PROFILE.\n");
+}
+
+}   // Anonymous namespace.
+
+int main(int argc, char *argv[])
+{
+    unsigned threads = std::thread::hardware_concurrency();
+    Budget defaults;
+    std::vector<std::string> lists;
+    std::vector<std::string> roms;
+    std::string profile_dir;
+    bool block_cache = false;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "-j") == 0 && has_value) {
+            threads = unsigned(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "-f") == 0 && has_value) {
+            defaults.frames = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-c") == 0 && has_value) {
+            defaults.cycles = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-l") == 0 && has_value) {
+            lists.push_back(argv[++i]);
+        } else if (std::strcmp(argv[i], "-b") == 0) {
+            block_cache = true;
+        } else if (std::strcmp(argv[i], "-p") == 0 && has_value) {
+            profile_dir = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else {
+            roms.push_back(argv[i]);
+        }
+    }
+    if (defaults.frames == 0 && defaults.cycles == 0) {
+        defaults.frames = 600;
+    }
+
+    std::vector<Job> jobs;
+    for (const auto &rom : roms) {
+        jobs.push_back({rom, defaults, {}, false});
+    }
+    for (const auto &list : lists) {
+        std::ifstream file(list);
+        if (!file.is_open()) {
+            fmt::print(stderr, "Failed to open {}\n", list);
+            return 1;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            Job job;
+            if (line.empty() || line[0] == '#' || !parse_job(line, defaults, job)) {
+                continue;
+            }
+            jobs.push_back(job);
+        }
+    }
+    if (jobs.empty()) {
+        usage();
+        return 2;
+    }
+    for (Job &job : jobs) {
+        job.block_cache = block_cache;
+    }
+    if (!profile_dir.empty()) {
+        if (!NES_PROFILE) {
+            fmt::print(stderr, "nes-batch was built without NES_PROFILE.\n");
+            return 2;
+        }
+        // The index keeps ROMs with the same name apart.
+        for (size_t i = 0; i < jobs.size(); i++) {
+            const std::string name = fmt::format("{}-{}", std::filesystem::path(jobs[i].path).stem().string(), i);
+            jobs[i].profile = (std::filesystem::path(profile_dir) / name).string();
+        }
+    }
+
+    // Each task writes only its own slot.
+    std::vector<Result> results(jobs.size());
+    const auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < jobs.size(); i++) {
+            pool.submit([&jobs, &results, i] { results[i] = run_job(jobs[i]); });
+        }
+        pool.wait();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    int failed = 0;
+    fmt::print("{:<16} {:>8} {:>12} {:>10} {:>9}  {}\n",
+               "hash", "frames", "cycles", "fps", "wall_s", "rom");
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const Result &r = results[i];
+        if (r.status != NesError::Success) {
+            fmt::print("{:<16} {:>8} {:>12} {:>10} {:>9.3f}  {} ({})\n",
+                       "-", r.frames, r.cycles, "-", r.seconds, jobs[i].path, error_name(r.status));
+            failed++;
+            continue;
+        }
+        const double fps = (r.seconds > 0.0) ? r.frames / r.seconds : 0.0;
+        fmt::print("{:016x} {:>8} {:>12} {:>10.1f} {:>9.3f}  {}\n",
+                   r.hash, r.frames, r.cycles, fps, r.seconds, jobs[i].path);
+    }
+    fmt::print("{} roms, {} failed, {:.3f}s on {} threads\n", jobs.size(), failed,
+               std::chrono::duration<double>(end - start).count(), std::max(threads, 1u));
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+// bus.cpp
+//
+#include "bus.h"
+
+namespace bus {
+
+Bus::Bus()
+{
+    read_pages.fill(nullptr);
+    write_pages.fill(nullptr);
+    devices.fill(&open_bus);
+    for (size_t page = 0; page < 256; page++) {
+        dirty_owner[page] = uint8_t(page);
+    }
+    mark_all_dirty();
+}
+
+void Bus::map_memory(uint8_t first_page, size_t count, uint8_t *mem, size_t size)
+{
+    for (size_t i = 0; i < count && first_page + i < 256; i++) {
+        uint8_t *page = mem + (i * PAGE_SIZE) % size;
+        read_pages[first_page + i]  = page;
+        write_pages[first_page + i] = page;
+        dirty_owner[first_page + i] = uint8_t(first_page + (i * PAGE_SIZE) % size / PAGE_SIZE);
+    }
+}
+
+void Bus::map_read(uint8_t first_page, size_t count, const uint8_t *mem, size_t size)
+{
+    for (size_t i = 0; i < count && first_page + i < 256; i++) {
+        read_pages[first_page + i] = mem + (i * PAGE_SIZE) % size;
+    }
+}
+
+void Bus::map_device(uint8_t first_page, size_t count, Device *device)
+{
+    for (size_t i = 0; i < count && first_page + i < 256; i++) {
+        read_pages[first_page + i]  = nullptr;
+        write_pages[first_page + i] = nullptr;
+        devices[first_page + i]     = device;
+    }
+}
+
+}   // Namespace bus.
@@ -0,0 +1,135 @@
+// bus.h : CPU address space split into 256 pages of 256 bytes.
+//
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Dirty page tracking costs a few instructions per memory write, builds
+// without it report every page as dirty.
+#if !defined(NES_DIRTY_PAGES)
+#define NES_DIRTY_PAGES 0
+#endif
+
+namespace bus {
+
+/// Memory-mapped I/O that cannot be served by plain memory, e.g. PPU and APU
+/// registers. Devices are only called for pages without backing memory.
+class Device {
+public:
+    virtual ~Device() = default;
+
+    /// Reads byte at given CPU address.
+    virtual uint8_t read(uint16_t addr) = 0;
+    /// Writes byte to given CPU address.
+    virtual void write(uint16_t addr, uint8_t val) = 0;
+};
+
+class Bus {
+public:
+    Bus();
+    // Page tables point at the bus' own open bus device.
+    Bus(const Bus&) = delete;
+    Bus &operator=(const Bus&) = delete;
+    ~Bus() = default;
+
+    static constexpr size_t PAGE_SIZE = 256;
+
+    /// Reads byte at given address. Pages with backing memory are a single
+    /// indexed load, everything else goes to the page's device.
+    inline uint8_t read(uint16_t addr)
+    {
+        const uint8_t *page = read_pages[addr >> 8];
+        if (page != nullptr) {
+            return page[addr & 0xff];
+        }
+        return devices[addr >> 8]->read(addr);
+    }
+
+    /// Writes byte to given address.
+    inline void write(uint16_t addr, uint8_t val)
+    {
+        uint8_t *page = write_pages[addr >> 8];
+        if (page != nullptr) {
+            page[addr & 0xff] = val;
+#if NES_DIRTY_PAGES
+            const uint8_t owner = dirty_owner[addr >> 8];
+            dirty[owner >> 6] |= uint64_t(1) << (owner & 63);
+#endif
+            return;
+        }
+        devices[addr >> 8]->write(addr, val);
+    }
+
+    /// Maps count pages starting at first_page onto mem for reading and
+    /// writing. If mem is smaller than the range it is mirrored. size must be
+    /// a multiple of PAGE_SIZE.
+    void map_memory(uint8_t first_page, size_t count, uint8_t *mem, size_t size);
+
+    /// Same as map_memory() but for reads only. Writes keep going to whatever
+    /// was mapped for writing before, usually a device.
+    void map_read(uint8_t first_page, size_t count, const uint8_t *mem, size_t size);
+
+    /// Sends all reads and writes of count pages starting at first_page to
+    /// device.
+    void map_device(uint8_t first_page, size_t count, Device *device);
+
+    /// Returns backing memory of the page containing addr, nullptr if the
+    /// page belongs to a device.
+    inline const uint8_t *read_page(uint16_t addr) const { return read_pages[addr >> 8]; }
+    /// True if writes to the page containing addr go to memory.
+    inline bool writable(uint16_t addr) const { return write_pages[addr >> 8] != nullptr; }
+
+    /// Reads addr if it is backed by memory, devices aren't called and read
+    /// as 0. For debugging and tracing.
+    inline uint8_t peek(uint16_t addr) const
+    {
+        const uint8_t *page = read_pages[addr >> 8];
+        return (page != nullptr) ? page[addr & 0xff] : 0x00;
+    }
+
+    /// True if memory behind page was written since the last clear_dirty().
+    /// Mirrors share one flag, a write to $0800 marks $0000 and the other way
+    /// around. Only writes through the bus count, see mark_all_dirty().
+    inline bool is_dirty(uint8_t page) const
+    {
+#if NES_DIRTY_PAGES
+        const uint8_t owner = dirty_owner[page];
+        return dirty[owner >> 6] & (uint64_t(1) << (owner & 63));
+#else
+        (void)page;
+        return true;
+#endif
+    }
+    /// Marks every page clean.
+    inline void clear_dirty() { dirty.fill(0); }
+    /// Marks every page dirty, for when memory changed behind the bus' back,
+    /// e.g. a state was restored.
+    inline void mark_all_dirty() { dirty.fill(~uint64_t(0)); }
+    /// One bit per page, bit n of word n / 64. Only the first page of each
+    /// group of mirrors is ever set.
+    inline const std::array<uint64_t, 4> &dirty_bitmap() const { return dirty; }
+
+private:
+    /// Unmapped pages read back the high byte of the address, which is what
+    /// is usually left floating on the data bus.
+    class OpenBus : public Device {
+    public:
+        uint8_t read(uint16_t addr) override { return uint8_t(addr >> 8); }
+        void write(uint16_t, uint8_t) override {}
+    };
+
+    std::array<const uint8_t *, 256> read_pages;
+    std::array<uint8_t *, 256> write_pages;
+    std::array<Device *, 256> devices;
+
+    // Page whose dirty flag a write to a page sets, the first page mapping
+    // the same memory.
+    std::array<uint8_t, 256> dirty_owner;
+    std::array<uint64_t, 4> dirty;
+
+    OpenBus open_bus;
+};
+
+}   // Namespace bus.
@@ -0,0 +1,122 @@
+// cartridge.cpp
+//
+#include "cartridge.h"
+
+// Header layout taken from:
+// https://wiki.nesdev.com/w/index.php/NES_2.0
+
+namespace {
+
+/// PRG/CHR ROM size from NES 2.0 LSB byte and MSB nibble. An MSB nibble of
+/// $F switches to exponent-multiplier notation: 2^E * (MM * 2 + 1).
+size_t rom_size(uint8_t lsb, uint8_t msb, size_t unit)
+{
+    if (msb == 0x0f) {
+        const unsigned exponent = lsb >> 2;
+        const size_t multiplier = (lsb & 0x03) * 2 + 1;
+        if (exponent >= 48) {   // Bigger than any file we could map.
+            return SIZE_MAX;
+        }
+        return (size_t(1) << exponent) * multiplier;
+    }
+    return ((size_t(msb) << 8) | lsb) * unit;
+}
+
+/// NES 2.0 RAM sizes are stored as a shift count, 0 means none.
+size_t ram_size(uint8_t shift)
+{
+    return shift == 0 ? 0 : size_t(64) << shift;
+}
+
+}   // Anonymous namespace.
+
+NesError Cartridge::parse_header(const uint8_t *data, CartridgeHeader &header)
+{
+    if (data[0] != 'N' || data[1] != 'E' || data[2] != 'S' || data[3] != 0x1a) {
+        return NesError::InvalidRom;
+    }
+
+    const uint8_t flags6 = data[6];
+    const uint8_t flags7 = data[7];
+
+    header = CartridgeHeader{};
+    header.nes2         = (flags7 & 0x0c) == 0x08;
+    header.battery      = flags6 & 0x02;
+    header.trainer      = flags6 & 0x04;
+    header.console_type = flags7 & 0x03;
+    if (flags6 & 0x08) {
+        header.mirroring = Mirroring::FourScreen;
+    } else if (flags6 & 0x01) {
+        header.mirroring = Mirroring::Vertical;
+    } else {
+        header.mirroring = Mirroring::Horizontal;
+    }
+
+    if (header.nes2) {
+        header.mapper       = (flags6 >> 4) | (flags7 & 0xf0) | (uint16_t(data[8] & 0x0f) << 8);
+        header.submapper    = data[8] >> 4;
+        header.prg_rom_size = rom_size(data[4], data[9] & 0x0f, 16 * 1024);
+        header.chr_rom_size = rom_size(data[5], data[9] >> 4, 8 * 1024);
+        header.prg_ram_size   = ram_size(data[10] & 0x0f);
+        header.prg_nvram_size = ram_size(data[10] >> 4);
+        header.chr_ram_size   = ram_size(data[11] & 0x0f);
+        header.chr_nvram_size = ram_size(data[11] >> 4);
+        header.timing = Timing(data[12] & 0x03);
+    } else {
+        // Bytes 12-15 should be zero. Old rippers wrote their name over bytes
+        // 7-15 ("DiskDude!"), in which case byte 7 can't be trusted either.
+        const bool dirty = data[12] || data[13] || data[14] || data[15];
+        header.mapper       = (flags6 >> 4) | (dirty ? 0 : (flags7 & 0xf0));
+        header.submapper    = 0;
+        header.prg_rom_size = size_t(data[4]) * 16 * 1024;
+        header.chr_rom_size = size_t(data[5]) * 8 * 1024;
+        // Byte 8 is PRG RAM in 8kB units, 0 meaning 8kB for compatibility.
+        const size_t prg_ram = (data[8] == 0 || dirty ? 1 : data[8]) * size_t(8 * 1024);
+        header.prg_ram_size   = header.battery ? 0 : prg_ram;
+        header.prg_nvram_size = header.battery ? prg_ram : 0;
+        header.chr_ram_size   = header.chr_rom_size == 0 ? 8 * 1024 : 0;
+        header.chr_nvram_size = 0;
+        header.timing = (!dirty && (data[9] & 0x01)) ? Timing::PAL : Timing::NTSC;
+    }
+    return NesError::Success;
+}
+
+NesError Cartridge::load(const std::string &path)
+{
+    prg = chr = trainer_data = nullptr;
+
+    const NesError err = file.open(path);
+    if (err != NesError::Success) {
+        return err;
+    }
+    if (file.size() < HEADER_SIZE || parse_header(file.data(), hdr) != NesError::Success) {
+        file.close();
+        return NesError::InvalidRom;
+    }
+
+    size_t offset = HEADER_SIZE;
+    const size_t trainer_size = hdr.trainer ? TRAINER_SIZE : 0;
+    // Mappers switch PRG in 8kB and CHR in 1kB banks at the smallest, NES 2.0
+    // sizes that aren't made of those can't be mapped. Compare by
+    // subtraction so oversized headers can't overflow the sum.
+    if (hdr.prg_rom_size == 0
+            || hdr.prg_rom_size % (8 * 1024) != 0
+            || hdr.chr_rom_size % 1024 != 0
+            || file.size() - offset < trainer_size
+            || file.size() - offset - trainer_size < hdr.prg_rom_size
+            || file.size() - offset - trainer_size - hdr.prg_rom_size < hdr.chr_rom_size) {
+        file.close();
+        return NesError::InvalidRom;
+    }
+
+    if (hdr.trainer) {
+        trainer_data = file.data() + offset;
+        offset += TRAINER_SIZE;
+    }
+    prg = file.data() + offset;
+    offset += hdr.prg_rom_size;
+    if (hdr.chr_rom_size != 0) {
+        chr = file.data() + offset;
+    }
+    return NesError::Success;
+}
@@ -0,0 +1,85 @@
+// cartridge.h : iNES/NES 2.0 ROM image.
+//
+#pragma once
+
+#include "mapped-file.h"
+#include "nes-error.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// Nametable layout. Horizontal/Vertical describe how the two physical
+/// nametables are mirrored.
+enum class Mirroring {
+    Horizontal,
+    Vertical,
+    SingleLower,
+    SingleUpper,
+    FourScreen,
+};
+
+/// Video timing the ROM was made for.
+enum class Timing {
+    NTSC,
+    PAL,
+    MultiRegion,
+    Dendy,
+};
+
+/// Parsed 16 byte iNES header. NES 2.0 only fields keep their iNES defaults
+/// for plain iNES images.
+struct CartridgeHeader {
+    bool nes2;              // NES 2.0 header.
+    uint16_t mapper;        // Mapper number.
+    uint8_t submapper;      // NES 2.0 only.
+    Mirroring mirroring;
+    bool battery;           // PRG RAM (or other memory) is battery backed.
+    bool trainer;           // 512 byte trainer before PRG ROM.
+    uint8_t console_type;   // 0: NES/Famicom, 1: Vs. System, 2: Playchoice 10, 3: Extended.
+    Timing timing;
+    size_t prg_rom_size;    // In bytes.
+    size_t chr_rom_size;    // In bytes. 0 means the board uses CHR RAM.
+    size_t prg_ram_size;    // Volatile PRG RAM in bytes.
+    size_t prg_nvram_size;  // Battery-backed PRG RAM in bytes.
+    size_t chr_ram_size;    // Volatile CHR RAM in bytes.
+    size_t chr_nvram_size;  // Battery-backed CHR RAM in bytes.
+};
+
+/// ROM image mapped straight from disk. PRG/CHR ROM and the trainer are
+/// read-only views into the mapping, nothing is copied.
+class Cartridge {
+public:
+    Cartridge() = default;
+    ~Cartridge() = default;
+
+    /// Maps the ROM at path and parses its header.
+    /// Returns CouldNotOpenFile if the file can't be mapped, InvalidRom if it
+    /// is not an iNES image or is shorter than its header says.
+    NesError load(const std::string &path);
+
+    /// Parses a 16 byte iNES/NES 2.0 header.
+    /// Returns InvalidRom if the magic number doesn't match.
+    static NesError parse_header(const uint8_t *data, CartridgeHeader &header);
+
+    inline const CartridgeHeader &header() const { return hdr; }
+    inline uint16_t mapper() const { return hdr.mapper; }
+    inline Mirroring mirroring() const { return hdr.mirroring; }
+
+    inline const uint8_t *prg_rom() const { return prg; }
+    inline size_t prg_rom_size() const { return hdr.prg_rom_size; }
+    inline const uint8_t *chr_rom() const { return chr; }
+    inline size_t chr_rom_size() const { return hdr.chr_rom_size; }
+    /// Returns nullptr if there is no trainer.
+    inline const uint8_t *trainer() const { return trainer_data; }
+
+    static constexpr size_t HEADER_SIZE  = 16;
+    static constexpr size_t TRAINER_SIZE = 512;
+
+private:
+    MappedFile file;
+    CartridgeHeader hdr{};
+    const uint8_t *prg = nullptr;
+    const uint8_t *chr = nullptr;
+    const uint8_t *trainer_data = nullptr;
+};
@@ -0,0 +1,172 @@
+// console.cpp
+//
+#include "console.h"
+
+Console::Console()
+    : internal_ram(std::make_unique<uint8_t[]>(RAM_SIZE)),
+      apu_chip(address_bus),
+      cpu_chip(address_bus),
+      state_bytes(0),
+      tracer(nullptr)
+{
+#if NES_PROFILE
+    profiler = nullptr;
+#endif
+    // RAM is mirrored up to $1FFF.
+    address_bus.map_memory(0x00, 0x20, internal_ram.get(), RAM_SIZE);
+    address_bus.map_device(0x20, 0x20, &ppu_chip);
+    address_bus.map_device(0x40, 0x01, &io_regs);
+    ppu_chip.set_cpu(&cpu_chip);
+    ppu_chip.set_interrupts(&cpu_chip.interrupts());
+    io_regs.set_apu(&apu_chip);
+    io_regs.set_dma(&address_bus, &ppu_chip, &cpu_chip);
+    apu_chip.set_cpu(&cpu_chip);
+    apu_chip.set_interrupts(&cpu_chip.interrupts());
+}
+
+NesError Console::load(const std::string &path)
+{
+    NesError err = cart.load(path);
+    if (err != NesError::Success) {
+        return err;
+    }
+    err = mapper::create(cart, address_bus, ppu_chip, board);
+    if (err != NesError::Success) {
+        return err;
+    }
+    board->set_interrupts(&cpu_chip.interrupts());
+    cpu_chip.reset();
+
+    state::Writer counter(nullptr, 0);
+    save_state(counter);
+    state_bytes = counter.used();
+    return NesError::Success;
+}
+
+void Console::reset()
+{
+    apu_chip.reset();
+    cpu_chip.interrupt(cpu::Interrupt::Reset);
+}
+
+void Console::save_state(state::Writer &state) const
+{
+    // Header: magic, version, total size, mapper number.
+    state.value(state::MAGIC);
+    state.value(state::VERSION);
+    state.value(uint32_t(state_bytes));
+    state.value(cart.mapper());
+
+    state.bytes(internal_ram.get(), RAM_SIZE);
+    cpu_chip.save_state(state);
+    ppu_chip.save_state(state);
+    apu_chip.save_state(state);
+    io_regs.save_state(state);
+    board->save_state(state);
+}
+
+NesError Console::snapshot(uint8_t *buf, size_t size) const
+{
+    if (board == nullptr) {
+        return NesError::Err;
+    }
+    if (size < state_bytes) {
+        return NesError::BufferTooSmall;
+    }
+    state::Writer state(buf, size);
+    save_state(state);
+    return NesError::Success;
+}
+
+NesError Console::restore(const uint8_t *buf, size_t size)
+{
+    if (board == nullptr) {
+        return NesError::Err;
+    }
+    state::Reader state(buf, size);
+    uint32_t magic, version, bytes;
+    uint16_t mapper;
+    state.value(magic);
+    state.value(version);
+    state.value(bytes);
+    state.value(mapper);
+    // The size covers RAM sizes, so a matching one means the rest of the
+    // layout matches too.
+    if (magic != state::MAGIC || version != state::VERSION || bytes != state_bytes
+            || size < state_bytes || mapper != cart.mapper()) {
+        return NesError::InvalidState;
+    }
+
+    // The board maps its banks again while loading, which mustn't run the
+    // half restored PPU.
+    ppu_chip.set_cpu(nullptr);
+    apu_chip.set_cpu(nullptr);
+    state.bytes(internal_ram.get(), RAM_SIZE);
+    cpu_chip.load_state(state);
+    ppu_chip.load_state(state);
+    apu_chip.load_state(state);
+    io_regs.load_state(state);
+    board->load_state(state);
+    address_bus.mark_all_dirty();
+    ppu_chip.set_cpu(&cpu_chip);
+    apu_chip.set_cpu(&cpu_chip);
+    return NesError::Success;
+}
+
+void Console::set_profile(profile::Profile *profile)
+{
+#if NES_PROFILE
+    profiler = profile;
+    if (profiler != nullptr) {
+        profiler->clear(ppu_chip.frame_count());
+    }
+#endif
+    cpu_chip.set_profile(profile);
+    ppu_chip.set_profile(profile);
+}
+
+NesError Console::step()
+{
+    // Interrupt sequences don't show up as instructions.
+    if (tracer != nullptr && !cpu_chip.interrupt_due()) {
+        ppu_chip.run_until(cpu_chip.cycles());
+        trace::Record rec = {};
+        cpu_chip.trace_record(rec);
+        rec.scanline = uint16_t(ppu_chip.scanline());
+        rec.dot = uint16_t(ppu_chip.dot());
+        tracer->push(rec);
+    }
+    if (cpu_chip.step() == 0) {
+        return NesError::InvalidOpcode;
+    }
+
+    // Register accesses catch the PPU and the APU up by themselves, they
+    // only have to be run here when about to raise an interrupt, clock a
+    // mapper's IRQ counter or hand out sound.
+    if (cpu_chip.cycles() >= ppu_chip.next_event()) {
+        // The PPU times its own catching up, here and on register accesses.
+        ppu_chip.run_until(cpu_chip.cycles());
+#if NES_PROFILE
+        if (profiler != nullptr) {
+            profiler->set_frame(ppu_chip.frame_count());
+        }
+#endif
+    }
+    if (cpu_chip.cycles() >= apu_chip.next_event()) {
+        apu_chip.run_until(cpu_chip.cycles());
+    }
+    return NesError::Success;
+}
+
+NesError Console::run_frame()
+{
+    const uint64_t frame = ppu_chip.frame_count();
+    while (ppu_chip.frame_count() == frame) {
+        const NesError err = step();
+        if (err != NesError::Success) {
+            return err;
+        }
+    }
+    apu_chip.end_frame();
+    return NesError::Success;
+}
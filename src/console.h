@@ -0,0 +1,107 @@
+// console.h : A complete NES. The console owns every component and all of its
+// memory and keeps no global state, so any number of consoles can run side by
+// side, one per thread.
+//
+#pragma once
+
+#include "apu/apu.h"
+#include "bus.h"
+#include "cartridge.h"
+#include "cpu/cpu.h"
+#include "io.h"
+#include "mapper/mapper.h"
+#include "nes-error.h"
+#include "ppu/ppu.h"
+#include "profile.h"
+#include "state.h"
+#include "trace.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class Console {
+public:
+    Console();
+    // Components point at each other.
+    Console(const Console&) = delete;
+    Console &operator=(const Console&) = delete;
+    ~Console() = default;
+
+    /// Inserts the cartridge at path and resets the CPU. Call once.
+    /// Returns the error of Cartridge::load() or mapper::create().
+    NesError load(const std::string &path);
+    /// Presses the reset button. The CPU jumps through the reset vector and
+    /// the APU goes quiet, RAM and the board keep their contents.
+    void reset();
+
+    /// Runs one CPU instruction, or the interrupt sequence if the PPU or the
+    /// board asked for one. The PPU is left behind and only caught up
+    /// when the CPU could tell, see ppu::PPU::next_event(); call
+    /// ppu().run_until(cpu().cycles()) to see where it would be now.
+    /// Returns InvalidOpcode if the CPU hit an unknown opcode.
+    NesError step();
+    /// Runs until the PPU enters the next vblank, i.e. finishes a frame, and
+    /// makes the frame's sound readable from apu().
+    NesError run_frame();
+
+    /// Turn drawing or mixing sound on or off, for frames nobody will see or
+    /// hear. Everything the CPU can observe still happens the same, see
+    /// ppu::PPU::set_output() and apu::APU::set_output().
+    inline void set_video_output(bool enabled) { ppu_chip.set_output(enabled); }
+    inline void set_audio_output(bool enabled) { apu_chip.set_output(enabled); }
+
+    /// Records every instruction step() runs into writer, nullptr to stop.
+    inline void set_trace(trace::Writer *writer) { tracer = writer; }
+    /// Profiles instructions and frame times into profile, nullptr to stop.
+    /// Does nothing unless built with NES_PROFILE.
+    void set_profile(profile::Profile *profile);
+
+    /// Bytes snapshot() writes. Only valid once a cartridge is loaded, it
+    /// depends on the board's RAM sizes.
+    inline size_t state_size() const { return state_bytes; }
+    /// Writes the whole console state to buf, state_size() bytes. Doesn't
+    /// allocate. Returns BufferTooSmall if size is less than state_size().
+    NesError snapshot(uint8_t *buf, size_t size) const;
+    /// Restores a state written by snapshot() on a console running the same
+    /// cartridge. Doesn't allocate. Returns InvalidState, leaving the console
+    /// untouched, if buf doesn't hold such a state.
+    NesError restore(const uint8_t *buf, size_t size);
+
+    inline cpu::CPU &cpu() { return cpu_chip; }
+    inline ppu::PPU &ppu() { return ppu_chip; }
+    inline apu::APU &apu() { return apu_chip; }
+    inline bus::Bus &bus() { return address_bus; }
+    inline io::Registers &io() { return io_regs; }
+    inline const cpu::CPU &cpu() const { return cpu_chip; }
+    inline const ppu::PPU &ppu() const { return ppu_chip; }
+    inline const Cartridge &cartridge() const { return cart; }
+    /// nullptr until a cartridge is loaded.
+    inline mapper::Mapper *mapper() { return board.get(); }
+
+    /// 2kB of internal RAM ($0000-$07FF).
+    inline const uint8_t *ram() const { return internal_ram.get(); }
+    static constexpr size_t RAM_SIZE = 2 * 1024;
+
+private:
+    // Declaration order matters, the CPU reads its reset vector through the
+    // bus when constructed.
+    std::unique_ptr<uint8_t[]> internal_ram;
+    Cartridge cart;
+    ppu::PPU ppu_chip;
+    io::Registers io_regs;
+    bus::Bus address_bus;
+    apu::APU apu_chip;
+    std::unique_ptr<mapper::Mapper> board;
+    cpu::CPU cpu_chip;
+
+    /// Writes every component's state after the header.
+    void save_state(state::Writer &state) const;
+
+    size_t state_bytes;
+    trace::Writer *tracer;
+#if NES_PROFILE
+    profile::Profile *profiler;
+#endif
+};
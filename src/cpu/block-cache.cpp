@@ -0,0 +1,124 @@
+// block-cache.cpp
+//
+#include "cpu/block-cache.h"
+#include "cpu/opcodes.h"
+
+#include <cstring>
+
+namespace cpu {
+
+namespace {
+
+/// True if instr changes the flow of execution.
+bool ends_block(Instr instr)
+{
+    switch (instr) {
+    case Instr::BCC: case Instr::BCS: case Instr::BEQ: case Instr::BNE:
+    case Instr::BMI: case Instr::BPL: case Instr::BVC: case Instr::BVS:
+    case Instr::JMP: case Instr::JSR: case Instr::RTS: case Instr::RTI:
+    case Instr::BRK:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// True if the instruction writes memory.
+bool writes_memory(const OpcodeInfo &info)
+{
+    switch (info.instr) {
+    case Instr::STA: case Instr::STX: case Instr::STY: case Instr::INC:
+    case Instr::DEC: case Instr::PHA: case Instr::PHP: case Instr::SAX:
+    case Instr::DCP: case Instr::ISB: case Instr::SLO: case Instr::RLA:
+    case Instr::SRE: case Instr::RRA:
+        return true;
+    case Instr::ASL: case Instr::LSR: case Instr::ROL: case Instr::ROR:
+        return info.mode != AddrMode::Accumulator;
+    default:
+        return false;
+    }
+}
+
+inline size_t slot(const uint8_t *code)
+{
+    const uintptr_t key = reinterpret_cast<uintptr_t>(code);
+    return (key ^ (key >> 11) ^ (key >> 22)) % BlockCache::ENTRIES;
+}
+
+}   // Anonymous namespace.
+
+BlockCache::BlockCache()
+    : blocks(ENTRIES)
+{
+    clear();
+}
+
+void BlockCache::clear()
+{
+    for (Block &block : blocks) {
+        block.code = nullptr;
+        block.page = nullptr;
+    }
+    hit_count = 0;
+    miss_count = 0;
+}
+
+const Block *BlockCache::lookup(const bus::Bus &bus, uint16_t pc)
+{
+    const uint8_t *page = bus.read_page(pc);
+    if (page == nullptr) {
+        return nullptr;
+    }
+    const uint8_t *code = page + (pc & 0xff);
+    Block &block = blocks[slot(code)];
+    if (block.code == code && block.pc == pc
+            && (!block.writable || std::memcmp(block.bytes, code, block.size) == 0)) {
+        hit_count++;
+    } else {
+        miss_count++;
+        decode(bus, pc, block);
+    }
+    return (block.count != 0) ? &block : nullptr;
+}
+
+void BlockCache::decode(const bus::Bus &bus, uint16_t pc, Block &block)
+{
+    const uint8_t *page = bus.read_page(pc);
+    block.code = page + (pc & 0xff);
+    block.page = page;
+    block.pc = pc;
+    block.count = 0;
+    block.writable = bus.writable(pc);
+
+    unsigned offset = pc & 0xff;
+    while (block.count < Block::MAX_OPS && offset < bus::Bus::PAGE_SIZE) {
+        const uint8_t opcode = page[offset];
+        const OpcodeInfo &info = OPCODES[opcode];
+        if (info.instr == Instr::Invalid || offset + info.bytes > bus::Bus::PAGE_SIZE) {
+            break;
+        }
+        BlockOp &op = block.ops[block.count++];
+        op.pc = uint16_t((pc & 0xff00) | offset);
+        op.next_pc = uint16_t(op.pc + info.bytes);
+        op.operand = 0;
+        if (info.bytes > 1) {
+            op.operand = page[offset + 1];
+        }
+        if (info.bytes > 2) {
+            op.operand |= uint16_t(page[offset + 2] << 8);
+        }
+        op.opcode = opcode;
+        offset += info.bytes;
+
+        if (ends_block(info.instr) || (block.writable && writes_memory(info))) {
+            break;
+        }
+    }
+
+    block.size = uint8_t(offset - (pc & 0xff));
+    if (block.writable) {
+        std::memcpy(block.bytes, block.code, block.size);
+    }
+}
+
+}   // Namespace cpu.
@@ -0,0 +1,73 @@
+// block-cache.h : Pre-decoded basic blocks for CPU::step(). A block is a run of
+// instructions up to the next jump, branch or return, with opcodes and
+// operands already read from memory. Blocks never leave the 256 byte bus page
+// they start in.
+//
+#pragma once
+
+#include "bus.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cpu {
+
+/// One decoded instruction.
+struct BlockOp {
+    uint16_t pc;        // Address of the opcode.
+    uint16_t next_pc;   // Address of the following instruction.
+    uint16_t operand;   // Operand bytes, low byte first.
+    uint8_t opcode;
+};
+
+struct Block {
+    static constexpr int MAX_OPS = 16;
+
+    /// Where the block starts in the memory backing the bus, so a bank
+    /// switch leads to another block rather than a stale one. This is the
+    /// cache key, together with pc for mirrored memory.
+    const uint8_t *code;
+    /// Bus page the block was decoded from.
+    const uint8_t *page;
+    uint16_t pc;
+    uint8_t count;      // 0 if the first instruction can't be decoded.
+    uint8_t size;       // Bytes of code.
+    /// Code in RAM is checked against bytes on every entry. Such blocks end
+    /// after the first instruction that writes memory, so they can't change
+    /// themselves.
+    bool writable;
+    BlockOp ops[MAX_OPS];
+    uint8_t bytes[MAX_OPS * 3];
+};
+
+/// Direct-mapped cache of blocks. A block that collides with another is
+/// decoded again on its next use.
+class BlockCache {
+public:
+    static constexpr size_t ENTRIES = 2048;
+
+    BlockCache();
+
+    /// Returns the block starting at pc, decoding it unless a current one is
+    /// cached. nullptr if pc isn't backed by memory or its instruction can't
+    /// be decoded (invalid opcode, crosses a page), the caller then has to
+    /// interpret it.
+    const Block *lookup(const bus::Bus &bus, uint16_t pc);
+
+    /// Drops every block.
+    void clear();
+
+    /// Lookups that found a current block, and ones that had to decode.
+    inline uint64_t hits() const { return hit_count; }
+    inline uint64_t misses() const { return miss_count; }
+
+private:
+    static void decode(const bus::Bus &bus, uint16_t pc, Block &block);
+
+    std::vector<Block> blocks;
+    uint64_t hit_count;
+    uint64_t miss_count;
+};
+
+}   // Namespace cpu.
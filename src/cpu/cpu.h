@@ -2,11 +2,25 @@
 //
 #pragma once
 
+#include "bus.h"
+#include "cpu/block-cache.h"
+#include "cpu/interrupts.h"
+#include "cpu/opcodes.h"
 #include "nes-error.h"
 #include "nes-utils.h"
+#include "profile.h"
+#include "state.h"
+#include "trace.h"
 
 #include <cstdint>
-#include <fstream>
+#include <memory>
+
+// Computed goto is a GCC/Clang extension, everything else uses the handler
+// table.
+#if !defined(NES_COMPUTED_GOTO) || !(defined(__GNUC__) || defined(__clang__))
+#undef NES_COMPUTED_GOTO
+#define NES_COMPUTED_GOTO 0
+#endif
 
 namespace cpu {
 
@@ -19,29 +33,142 @@ enum class Interrupt {
 
 class CPU {
 public:
-    CPU(uint8_t ram[]);
+    CPU(bus::Bus &bus);
     // CPU(CPU&) = default;
     // CPU(const CPU&) = default;
     ~CPU() = default;
 
+    /// Puts the registers in their power-up state and jumps to the reset
+    /// vector at $FFFC.
+    void reset();
+    /// Continues execution at addr.
+    inline void set_program_counter(uint16_t addr)
+    {
+        program_counter = addr;
+        cursor = cursor_end = nullptr;
+    }
+    /// Address of the next instruction.
+    inline uint16_t pc() const { return program_counter; }
+
     /// Returns value at address given by program counter.
-    inline uint8_t fetch() { return ram[program_counter++]; }
-    /// Executes given opcode.
-    /// Returns ERROR if given an unknown opcode.
-    NesError execute(uint8_t opcode);
+    inline uint8_t fetch() { return bus->read(program_counter++); }
+    /// Executes given opcode. Dispatch goes through the OPCODES decode table,
+    /// either with computed goto or a handler table (see NES_COMPUTED_GOTO).
+    /// Returns the number of cycles the instruction took, base cycles plus
+    /// page-cross and branch penalties. Returns 0 if given an unknown opcode.
+    inline uint32_t execute(uint8_t opcode)
+    {
+        const OpcodeInfo &info = OPCODES[opcode];
+        if (info.instr == Instr::Invalid) {
+            return 0;
+        }
+#if NES_PROFILE
+        // fetch() already moved past the opcode.
+        const uint16_t pc = uint16_t(program_counter - 1);
+#endif
+        operand = 0;
+        if (info.bytes > 1) {
+            operand = fetch();
+        }
+        if (info.bytes > 2) {
+            operand |= uint16_t(fetch() << 8);
+        }
 
-    /// Triggers interrupt the given interrupt.
+        const uint32_t used = dispatch(opcode);
+#if NES_PROFILE
+        if (profiler != nullptr) {
+            profiler->instruction(opcode, pc, used);
+        }
+#endif
+        return used;
+    }
+    /// Runs the next instruction, taking it from the block cache if enabled.
+    /// Same result as execute(fetch()). If an interrupt is due it is taken
+    /// instead, which runs no instruction and takes 7 cycles. Cycles stalled
+    /// for DMA since the last step() are added, so the results add up to
+    /// cycles(). Returns 0 on an unknown opcode.
+    inline uint32_t step()
+    {
+        uint32_t used = 0;
+        if (lines.pending() != 0) {
+            used = poll_interrupts();
+        }
+        if (used == 0) {
+            used = (blocks == nullptr) ? execute(fetch()) : step_cached();
+            if (used == 0) {
+                return 0;
+            }
+        }
+        used += stalled;
+        stalled = 0;
+        return used;
+    }
+
+    /// Turns the block cache on or off. Turning it on starts out empty.
+    void set_block_cache(bool enabled);
+    /// nullptr while disabled.
+    inline const BlockCache *block_cache() const { return blocks.get(); }
+
+    /// Returns total number of cycles executed since power up.
+    inline uint64_t cycles() const { return cycle_count; }
+    /// Cycle of the current instruction's last cycle without penalties, where
+    /// its reads and writes mostly happen. Same as cycles() between
+    /// instructions.
+    inline uint64_t bus_cycle() const { return cycle_count + access_offset; }
+
+    /// Adds cycles the CPU sits halted while DMA has the bus. They count as
+    /// part of the current instruction, or the next one if there is none,
+    /// and step() returns them with it.
+    inline void stall(uint32_t cycles)
+    {
+        cycle_count += cycles;
+        stalled += cycles;
+    }
+    /// NMI and IRQ lines devices drive. step() takes what they ask for.
+    inline Interrupts &interrupts() { return lines; }
+    /// True if the next step() takes an interrupt: an NMI is pending, or IRQ
+    /// is asserted and not masked by the I flag.
+    inline bool interrupt_due() const
+    {
+        if (lines.nmi()) {
+            return true;
+        }
+        if (!lines.irq()) {
+            return false;
+        }
+        const uint8_t flags = (cycle_count == delayed_flag_cycle) ? delayed_flag : status;
+        return !(flags & INTERRUPT);
+    }
+    /// Runs the interrupt sequence: pushes PC and status (except on Reset,
+    /// which only moves the stack pointer), sets I and jumps through the
+    /// vector, $FFFA for NMI, $FFFC for Reset and $FFFE for IRQ and BRK.
+    /// Takes 7 cycles, which BRK already counts as an instruction.
     void interrupt(Interrupt interr);
 
-    // TODO: Delete.
-    NesError run();
+    /// Appends registers, cycle count and interrupt lines to state.
+    void save_state(state::Writer &state) const;
+    /// Reads back what save_state() wrote.
+    void load_state(state::Reader &state);
 
     // TODO: Tell the format.
     /// Prints CPU registers.
     void print() const;
 
-    /// Same as print() but to a file.
-    void fprint(std::ofstream &file) const;
+    /// Fills rec with the registers and the bytes of the instruction about to
+    /// execute. Bytes are only read from memory pages so devices don't see
+    /// the reads. Leaves the PPU position alone.
+    void trace_record(trace::Record &rec) const;
+
+    /// Counts every executed instruction into profile, nullptr to stop. Does
+    /// nothing unless built with NES_PROFILE.
+    inline void set_profile(profile::Profile *profile)
+    {
+#if NES_PROFILE
+        profiler = profile;
+#else
+        (void)profile;
+#endif
+    }
 
 private:
     /***************************************************
@@ -77,8 +204,81 @@ private:
     uint8_t y_index;
     uint8_t status;
 
-    // Shared memory.
-    uint8_t *ram;
+    // Total cycles executed. Power up takes 7 cycles.
+    uint64_t cycle_count;
+    // Set by indexed addressing modes when the index crosses a page.
+    bool page_crossed;
+    // Cycles added by the current instruction on top of the decode table,
+    // e.g. taken branches.
+    uint8_t extra_cycles;
+    // Base cycles of the current instruction minus one, 0 between
+    // instructions.
+    uint8_t access_offset;
+    // DMA cycles step() hasn't returned yet.
+    uint32_t stalled;
+
+    Interrupts lines;
+    // CLI, SEI and PLP change I after the CPU polled for interrupts, so at
+    // delayed_flag_cycle, the end of such an instruction, the I flag of
+    // delayed_flag still counts.
+    uint64_t delayed_flag_cycle;
+    uint8_t delayed_flag;
+
+    /// Remembers I for interrupt_due() before an instruction of given
+    /// cycles changes it.
+    inline void delay_interrupt_flag(uint8_t cycles)
+    {
+        delayed_flag = status;
+        delayed_flag_cycle = cycle_count + cycles;
+    }
+
+    // Operand bytes of the current instruction, low byte first.
+    uint16_t operand;
+
+    // CPU address space.
+    bus::Bus *bus;
+
+    // Block cache and the rest of the block step() is in, cursor is the next
+    // instruction to run.
+    std::unique_ptr<BlockCache> blocks;
+    const BlockOp *cursor;
+    const BlockOp *cursor_end;
+    const uint8_t *cursor_page;
+
+    /// Runs opcode, whose operand has been read, and counts its cycles.
+    uint32_t dispatch(uint8_t opcode);
+    /// step() with the block cache enabled.
+    uint32_t step_cached();
+    /// Takes a due interrupt, returns its cycles or 0 if none is due.
+    uint32_t poll_interrupts();
+
+#if NES_PROFILE
+    profile::Profile *profiler;
+#endif
+
+#if !NES_COMPUTED_GOTO
+    /// One handler per opcode, generated from opcodes.def.
+#define CPU_OPCODE(code, instr, mode, bytes, cycles, page, ...) void op_##code();
+#include "cpu/opcodes.def"
+#undef CPU_OPCODE
+
+    using Handler = void (CPU::*)();
+    /// Handlers indexed by opcode.
+    static const Handler HANDLERS[256];
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+    inline uint8_t read(uint16_t addr) { return bus->read(addr); }
+    inline void write(uint16_t addr, uint8_t val) { bus->write(addr, val); }
+
+    /// Read-modify-write of memory for the shift and rotate instructions.
+    inline void modify(uint16_t addr, void (CPU::*op)(uint8_t *))
+    {
+        uint8_t val = read(addr);
+        (this->*op)(&val);
+        write(addr, val);
+    }
 
 /*----------------------------------------------------------------------------*/
 
@@ -86,58 +286,50 @@ private:
      * Addressing mode functions. *
      ******************************/
     // Returns address or value that is computed by chosen address mode.
+    // Operand bytes were already read into operand.
     //
-    inline int8_t  relative()            { return int8_t(fetch()); }
-    inline uint8_t immediate()           { return fetch(); }
+    inline int8_t  relative()            { return int8_t(operand); }
+    inline uint8_t immediate()           { return uint8_t(operand); }
     inline uint8_t *get_accumulator()    { return &accumulator; }
-    inline uint16_t zero_page()          { return fetch(); }
-    inline uint16_t zero_page_x()        { return (x_index + fetch()) % 256; }
-    inline uint16_t zero_page_y()        { return (y_index + fetch()) % 256; }
-
-    inline uint16_t absolute()          
-    {
-        const uint16_t addr_low  = fetch();
-        const uint16_t addr_high = fetch() << 8;
-        return (addr_high | addr_low);
-    }
-
-    inline uint16_t absolute_x()        
-    {
-        const uint16_t addr_low  = fetch();
-        const uint16_t addr_high = fetch() << 8;
-        return (addr_high | addr_low) + x_index;
-    }
+    inline uint16_t zero_page()          { return uint8_t(operand); }
+    inline uint16_t zero_page_x()        { return (x_index + operand) % 256; }
+    inline uint16_t zero_page_y()        { return (y_index + operand) % 256; }
 
-    inline uint16_t absolute_y()        
-    {
-        const uint16_t addr_low  = fetch();
-        const uint16_t addr_high = fetch() << 8;
-        return (addr_high | addr_low) + y_index;
-    }
+    inline uint16_t absolute()           { return operand; }
+    inline uint16_t absolute_x()         { return indexed(operand, x_index); }
+    inline uint16_t absolute_y()         { return indexed(operand, y_index); }
 
     inline uint16_t indirect()
     {
-        const uint16_t addr_low  = fetch();
-        const uint16_t addr_high = fetch() << 8;
-        const uint16_t new_low = ram[addr_high | addr_low];
+        const uint16_t addr_low  = low_byte(operand);
+        const uint16_t addr_high = operand & 0xff00;
+        const uint16_t new_low = read(addr_high | addr_low);
         // An original 6502 has does not correctly fetch the target address if the
         // indirect vector falls on a page boundary (e.g. $xxFF where xx is any value
         // from $00 to $FF). In this case fetches the LSB from $xxFF as expected but
         // takes the MSB from $xx00.
-        const uint16_t new_high = ram[addr_high | uint8_t((addr_low + 1))] << 8;
+        const uint16_t new_high = read(addr_high | uint8_t((addr_low + 1))) << 8;
         return (new_high | new_low);
     }
 
-    inline uint16_t indexed_indirect()  
+    inline uint16_t indexed_indirect()
+    {
+        const uint8_t val = uint8_t(operand);
+        return read((val + x_index) % 256) + read((val + x_index + 1) % 256) * 256;
+    }
+
+    inline uint16_t indirect_indexed()
     {
-        const uint8_t val = fetch();
-        return ram[(val + x_index) % 256] + ram[(val + x_index + 1) % 256] * 256;
+        const uint8_t val = uint8_t(operand);
+        return indexed(read(val) + read((val + 1) % 256) * 256, y_index);
     }
 
-    inline uint16_t indirect_indexed()  
+    /// Adds index to base address, noting if the result lands on another page.
+    inline uint16_t indexed(uint16_t base, uint8_t index)
     {
-        const uint8_t val = fetch();
-        return ram[val] + ram[(val + 1) % 256] * 256 + y_index;
+        const uint16_t addr = base + index;
+        page_crossed = high_byte(base) != high_byte(addr);
+        return addr;
     }
 
 /*----------------------------------------------------------------------------*/
@@ -145,7 +337,7 @@ private:
     /// Pushes value to stack.
     inline void stack_push(uint8_t val)
     {
-        ram[STACK_BASE + stack_pointer] = val;
+        write(STACK_BASE + stack_pointer, val);
         stack_pointer--;
     }
 
@@ -153,7 +345,7 @@ private:
     inline uint8_t stack_pop()
     {
         stack_pointer++;
-        return ram[STACK_BASE + stack_pointer];
+        return read(STACK_BASE + stack_pointer);
     }
 
     /// Set zero flag if given value equals 0, otherwise clear it.
@@ -180,6 +372,10 @@ private:
 
     // Instruction comments taken from:
     // http://obelisk.me.uk/6502/reference.html
+    /// Branches by the relative offset if condition is true. A taken branch
+    /// costs one extra cycle, two if it lands on another page.
+    void branch(bool condition);
+
     /*************************
      * Load/Store Operations *
      *************************/
@@ -453,6 +649,37 @@ private:
     /// routine. It pulls the processor flags from the stack followed by the
     /// program counter.
     void rti();
+
+    /**********************
+     * Unofficial Opcodes *
+     **********************/
+    // Combinations of the official instructions the decoder ends up running
+    // for undocumented opcodes. The ones nestest exercises are implemented.
+    //
+    /// LAX - Load Accumulator and X Register
+    /// LDA and LDX of the same byte.
+    void lax(uint8_t val);
+    /// SAX - Store Accumulator AND X Register
+    /// Stores A AND X into memory without changing any flags.
+    void sax(uint16_t addr);
+    /// DCP - Decrement and Compare
+    /// DEC of the memory location, then CMP with the result.
+    void dcp(uint16_t addr);
+    /// ISB - Increment and Subtract with Carry
+    /// INC of the memory location, then SBC of the result.
+    void isb(uint16_t addr);
+    /// SLO - Shift Left and OR
+    /// ASL of the memory location, then ORA of the result.
+    void slo(uint16_t addr);
+    /// RLA - Rotate Left and AND
+    /// ROL of the memory location, then AND of the result.
+    void rla(uint16_t addr);
+    /// SRE - Shift Right and Exclusive OR
+    /// LSR of the memory location, then EOR of the result.
+    void sre(uint16_t addr);
+    /// RRA - Rotate Right and Add with Carry
+    /// ROR of the memory location, then ADC of the result.
+    void rra(uint16_t addr);
 };
 
 }   // Namespace cpu.
\ No newline at end of file
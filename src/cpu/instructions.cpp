@@ -9,14 +9,14 @@ namespace cpu {
 
 // void CPU::stack_push(uint8_t val)
 // {
-//     ram[STACK_BASE + stack_pointer] = val;
+//     write(STACK_BASE + stack_pointer, val);
 //     stack_pointer--;
 // }
 
 // uint8_t CPU::stack_pop()
 // {
 //     stack_pointer++;
-//     return ram[STACK_BASE + stack_pointer];
+//     return read(STACK_BASE + stack_pointer);
 // }
 
 // void CPU::set_zero_if(uint8_t val)
@@ -67,17 +67,17 @@ void CPU::ldy(uint8_t val)
 
 void CPU::sta(uint16_t addr)
 {
-    ram[addr] = accumulator;
+    write(addr, accumulator);
 }
 
 void CPU::stx(uint16_t addr)
 {
-    ram[addr] = x_index;
+    write(addr, x_index);
 }
 
 void CPU::sty(uint16_t addr)
 {
-    ram[addr] = y_index;
+    write(addr, y_index);
 }
 
 /**********************
@@ -147,6 +147,7 @@ void CPU::pla()
 
 void CPU::plp()
 {
+    delay_interrupt_flag(4);
     status = stack_pop();
     status = clear_bit(status, BREAK);
     status = set_bit(status, EXPANSION);
@@ -311,9 +312,10 @@ void CPU::cpy(uint8_t val)
  ***************************/
 void CPU::inc(uint16_t addr)
 {
-    ram[addr]++;
-    set_zero_if(ram[addr]);
-    set_negative_if(ram[addr]);
+    const uint8_t val = read(addr) + 1;
+    write(addr, val);
+    set_zero_if(val);
+    set_negative_if(val);
 }
 
 void CPU::inx()
@@ -332,9 +334,10 @@ void CPU::iny()
 
 void CPU::dec(uint16_t addr)
 {
-    ram[addr]--;
-    set_zero_if(ram[addr]);
-    set_negative_if(ram[addr]);
+    const uint8_t val = read(addr) - 1;
+    write(addr, val);
+    set_zero_if(val);
+    set_negative_if(val);
 }
 
 void CPU::dex()
@@ -386,8 +389,8 @@ void CPU::rol(uint8_t *val)
 {
     uint8_t new_carry = *val & 0x80;
 
-    // Rotate left.
-    *val = (*val >> 7) | (*val << 1);
+    // Rotate left, the old carry goes into bit 0.
+    *val = (*val << 1) | (status & CARRY);
 
     if (new_carry) {
         status = set_bit(status, CARRY);
@@ -443,84 +446,54 @@ void CPU::rts()
 /************
  * Branches *
  ************/
-void CPU::bcc()
+void CPU::branch(bool condition)
 {
-    if (!(status & CARRY)) {
-        int8_t offset = relative();
-        program_counter += offset;
-    } else {
-        program_counter++;
+    if (condition) {
+        const int8_t offset = relative();
+        const uint16_t target = program_counter + offset;
+        extra_cycles += (high_byte(program_counter) != high_byte(target)) ? 2 : 1;
+        program_counter = target;
     }
 }
 
+void CPU::bcc()
+{
+    branch(!(status & CARRY));
+}
+
 void CPU::bcs()
 {
-    if (status & CARRY) {
-        int8_t offset = relative();
-        program_counter += offset;
-    } else {
-        program_counter++;
-    }
+    branch((status & CARRY) != 0);
 }
 
 void CPU::beq()
 {
-    if (status & ZERO) {
-        int8_t offset = relative();
-        program_counter += offset;
-    } else {
-        program_counter++;
-    }
+    branch((status & ZERO) != 0);
 }
 
 void CPU::bmi()
 {
-    if (status & NEGATIVE) {
-        int8_t offset = relative();
-        program_counter += offset;
-    } else {
-        program_counter++;
-    }
+    branch((status & NEGATIVE) != 0);
 }
 
 void CPU::bne()
 {
-    if (!(status & ZERO)) {
-        int8_t offset = relative();
-        program_counter += offset;
-    } else {
-        program_counter++;
-    }
+    branch(!(status & ZERO));
 }
 
 void CPU::bpl()
 {
-    if (!(status & NEGATIVE)) {
-        int8_t offset = relative();
-        program_counter += offset;
-    } else {
-        program_counter++;
-    }
+    branch(!(status & NEGATIVE));
 }
 
 void CPU::bvc()
 {
-    if (!(status & OVERFLW)) {
-        int8_t offset = relative();
-        program_counter += offset;
-    } else {
-        program_counter++;
-    }
+    branch(!(status & OVERFLW));
 }
 
 void CPU::bvs()
 {
-    if (status & OVERFLW) {
-        int8_t offset = relative();
-        program_counter += offset;
-    } else {
-        program_counter++;
-    }
+    branch((status & OVERFLW) != 0);
 }
 
 /***********************
@@ -538,6 +511,7 @@ void CPU::cld()
 
 void CPU::cli()
 {
+    delay_interrupt_flag(2);
     status = clear_bit(status, INTERRUPT);
 }
 
@@ -558,6 +532,7 @@ void CPU::sed()
 
 void CPU::sei()
 {
+    delay_interrupt_flag(2);
     status = set_bit(status, INTERRUPT);
 }
 
@@ -577,10 +552,71 @@ void CPU::nop()
 void CPU::rti()
 {
     status = stack_pop();
+    status = clear_bit(status, BREAK);
     status = set_bit(status, EXPANSION);
     const uint16_t pcl = stack_pop();
     const uint16_t pch = stack_pop() << 8;
     program_counter = (pch | pcl);
 }
 
+/**********************
+ * Unofficial Opcodes *
+ **********************/
+void CPU::lax(uint8_t val)
+{
+    lda(val);
+    x_index = accumulator;
+}
+
+void CPU::sax(uint16_t addr)
+{
+    write(addr, accumulator & x_index);
+}
+
+void CPU::dcp(uint16_t addr)
+{
+    const uint8_t val = read(addr) - 1;
+    write(addr, val);
+    cmp(val);
+}
+
+void CPU::isb(uint16_t addr)
+{
+    const uint8_t val = read(addr) + 1;
+    write(addr, val);
+    sbc(val);
+}
+
+void CPU::slo(uint16_t addr)
+{
+    uint8_t val = read(addr);
+    asl(&val);
+    write(addr, val);
+    ora(val);
+}
+
+void CPU::rla(uint16_t addr)
+{
+    uint8_t val = read(addr);
+    rol(&val);
+    write(addr, val);
+    logical_and(val);
+}
+
+void CPU::sre(uint16_t addr)
+{
+    uint8_t val = read(addr);
+    lsr(&val);
+    write(addr, val);
+    eor(val);
+}
+
+void CPU::rra(uint16_t addr)
+{
+    uint8_t val = read(addr);
+    ror(&val);
+    write(addr, val);
+    adc(val);
+}
+
 }   // Namespace cpu.
\ No newline at end of file
@@ -0,0 +1,69 @@
+// interrupts.h : The CPU's interrupt inputs. Devices drive the NMI and IRQ
+// lines, the CPU only looks at pending() between instructions.
+//
+#pragma once
+
+#include "state.h"
+
+#include <cstdint>
+
+namespace cpu {
+
+/// Devices sharing the IRQ line, one bit of Interrupts::pending() each.
+enum class IrqSource : uint8_t {
+    Mapper   = 1 << 1,
+    ApuFrame = 1 << 2,
+    ApuDmc   = 1 << 3,
+};
+
+class Interrupts {
+public:
+    Interrupts() : pending_mask(0), nmi_level(false) {}
+
+    /// Sets the level of the NMI line. NMI is edge triggered, only a rising
+    /// edge makes one pending, holding the line high doesn't add more.
+    inline void set_nmi(bool level)
+    {
+        if (level && !nmi_level) {
+            pending_mask |= NMI_PENDING;
+        }
+        nmi_level = level;
+    }
+    /// Sets whether source pulls the IRQ line. IRQ is level triggered, it
+    /// stays asserted until every source lets go.
+    inline void set_irq(IrqSource source, bool level)
+    {
+        if (level) {
+            pending_mask |= uint8_t(source);
+        } else {
+            pending_mask &= uint8_t(~uint8_t(source));
+        }
+    }
+
+    /// Non-zero while an NMI is pending or any source holds IRQ, so a single
+    /// test covers both.
+    inline uint8_t pending() const { return pending_mask; }
+    inline bool nmi() const { return pending_mask & NMI_PENDING; }
+    inline bool irq() const { return pending_mask & ~NMI_PENDING; }
+    /// Called by the CPU once it starts servicing the pending NMI.
+    inline void acknowledge_nmi() { pending_mask &= uint8_t(~NMI_PENDING); }
+
+    void save_state(state::Writer &state) const
+    {
+        state.value(pending_mask);
+        state.value(nmi_level);
+    }
+    void load_state(state::Reader &state)
+    {
+        state.value(pending_mask);
+        state.value(nmi_level);
+    }
+
+private:
+    static constexpr uint8_t NMI_PENDING = 1 << 0;
+
+    uint8_t pending_mask;
+    bool nmi_level;
+};
+
+}   // Namespace cpu.
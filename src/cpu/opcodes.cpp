@@ -0,0 +1,83 @@
+// opcodes.cpp
+//
+#include "cpu/opcodes.h"
+
+namespace cpu {
+
+namespace {
+
+/// Verifies that opcodes.def lists all 256 opcodes in order.
+constexpr bool opcodes_in_order()
+{
+    constexpr uint8_t codes[] = {
+#define CPU_OPCODE(code, instr, mode, bytes, cycles, page, ...) 0x##code,
+#include "cpu/opcodes.def"
+#undef CPU_OPCODE
+    };
+    if (sizeof(codes) != 256) {
+        return false;
+    }
+    for (int i = 0; i < 256; i++) {
+        if (codes[i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(opcodes_in_order(), "opcodes.def must list all 256 opcodes in order");
+
+}   // Anonymous namespace.
+
+const char *mnemonic(Instr instr)
+{
+    static constexpr const char *names[] = {
+        "???",
+        "ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI", "BNE", "BPL",
+        "BRK", "BVC", "BVS", "CLC", "CLD", "CLI", "CLV", "CMP", "CPX", "CPY",
+        "DEC", "DEX", "DEY", "EOR", "INC", "INX", "INY", "JMP", "JSR", "LDA",
+        "LDX", "LDY", "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL",
+        "ROR", "RTI", "RTS", "SBC", "SEC", "SED", "SEI", "STA", "STX", "STY",
+        "TAX", "TAY", "TSX", "TXA", "TXS", "TYA",
+        "DCP", "ISB", "LAX", "RLA", "RRA", "SAX", "SLO", "SRE",
+    };
+    return names[uint8_t(instr)];
+}
+
+bool unofficial(uint8_t opcode)
+{
+    switch (OPCODES[opcode].instr) {
+    case Instr::Invalid:
+    case Instr::DCP: case Instr::ISB: case Instr::LAX: case Instr::RLA:
+    case Instr::RRA: case Instr::SAX: case Instr::SLO: case Instr::SRE:
+        return true;
+    case Instr::NOP:
+        return opcode != 0xea;
+    case Instr::SBC:
+        return opcode == 0xeb;
+    default:
+        return false;
+    }
+}
+
+const char *mode_name(AddrMode mode)
+{
+    switch (mode) {
+    case AddrMode::Implied:         return "impl";
+    case AddrMode::Accumulator:     return "acc";
+    case AddrMode::Immediate:       return "imm";
+    case AddrMode::ZeroPage:        return "zp";
+    case AddrMode::ZeroPageX:       return "zp,x";
+    case AddrMode::ZeroPageY:       return "zp,y";
+    case AddrMode::Relative:        return "rel";
+    case AddrMode::Absolute:        return "abs";
+    case AddrMode::AbsoluteX:       return "abs,x";
+    case AddrMode::AbsoluteY:       return "abs,y";
+    case AddrMode::Indirect:        return "ind";
+    case AddrMode::IndexedIndirect: return "(zp,x)";
+    case AddrMode::IndirectIndexed: return "(zp),y";
+    }
+    return "???";
+}
+
+}   // Namespace cpu.
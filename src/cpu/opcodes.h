@@ -0,0 +1,66 @@
+// opcodes.h : Opcode metadata shared by the CPU and any tool that decodes
+// 6502 code (disassembler, tracer, profiler).
+//
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace cpu {
+
+/// Addressing modes of the 6502.
+enum class AddrMode : uint8_t {
+    Implied,
+    Accumulator,
+    Immediate,
+    ZeroPage,
+    ZeroPageX,
+    ZeroPageY,
+    Relative,
+    Absolute,
+    AbsoluteX,
+    AbsoluteY,
+    Indirect,
+    IndexedIndirect,
+    IndirectIndexed,
+};
+
+/// Instruction kinds. Invalid marks opcodes the CPU does not implement.
+enum class Instr : uint8_t {
+    Invalid,
+    ADC, AND, ASL, BCC, BCS, BEQ, BIT, BMI, BNE, BPL, BRK, BVC, BVS, CLC,
+    CLD, CLI, CLV, CMP, CPX, CPY, DEC, DEX, DEY, EOR, INC, INX, INY, JMP,
+    JSR, LDA, LDX, LDY, LSR, NOP, ORA, PHA, PHP, PLA, PLP, ROL, ROR, RTI,
+    RTS, SBC, SEC, SED, SEI, STA, STX, STY, TAX, TAY, TSX, TXA, TXS, TYA,
+    // Unofficial, only reachable through unofficial opcodes.
+    DCP, ISB, LAX, RLA, RRA, SAX, SLO, SRE,
+};
+
+/// Decoded metadata of a single opcode.
+struct OpcodeInfo {
+    Instr instr;
+    AddrMode mode;
+    uint8_t bytes;      // Instruction length, opcode included.
+    uint8_t cycles;     // Base cycle count, 0 for invalid opcodes.
+    bool page_cycle;    // Costs one more cycle when indexing crosses a page.
+};
+
+/// Decode table indexed by opcode.
+inline constexpr std::array<OpcodeInfo, 256> OPCODES = {{
+#define CPU_OPCODE(code, instr, mode, bytes, cycles, page, ...) \
+    { Instr::instr, AddrMode::mode, bytes, cycles, page },
+#include "cpu/opcodes.def"
+#undef CPU_OPCODE
+}};
+
+/// Returns the three letter mnemonic of the instruction, "???" if invalid.
+const char *mnemonic(Instr instr);
+
+/// True if opcode is not one of the 151 documented ones, e.g. the NOPs
+/// other than $EA and the SBC at $EB. nestest.log marks these with a '*'.
+bool unofficial(uint8_t opcode);
+
+/// Returns a short name of the addressing mode, e.g. "abs,x".
+const char *mode_name(AddrMode mode);
+
+}   // Namespace cpu.
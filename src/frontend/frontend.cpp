@@ -0,0 +1,268 @@
+// frontend.cpp
+//
+#include "frontend/frontend.h"
+#include "io.h"
+#include "ppu/palette.h"
+#include "run-ahead.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace frontend {
+
+namespace {
+
+/// Keyboard layout of the controller in port 0.
+struct Key {
+    SDL_Scancode scancode;
+    uint8_t button;
+};
+constexpr Key KEYS[] = {
+    { SDL_SCANCODE_X,      io::BUTTON_A },
+    { SDL_SCANCODE_Z,      io::BUTTON_B },
+    { SDL_SCANCODE_RSHIFT, io::BUTTON_SELECT },
+    { SDL_SCANCODE_RETURN, io::BUTTON_START },
+    { SDL_SCANCODE_UP,     io::BUTTON_UP },
+    { SDL_SCANCODE_DOWN,   io::BUTTON_DOWN },
+    { SDL_SCANCODE_LEFT,   io::BUTTON_LEFT },
+    { SDL_SCANCODE_RIGHT,  io::BUTTON_RIGHT },
+};
+
+}   // Anonymous namespace.
+
+Frontend::Frontend()
+    : window(nullptr),
+      renderer(nullptr),
+      texture(nullptr),
+      audio(0),
+      samples(AUDIO_LATENCY * 4),
+      running(false),
+      buttons(0),
+      presented(0),
+      crashed(false),
+      frames_run(0)
+{
+}
+
+Frontend::~Frontend()
+{
+    stop();
+    if (audio != 0) {
+        SDL_CloseAudioDevice(audio);
+    }
+    if (texture != nullptr) {
+        SDL_DestroyTexture(texture);
+    }
+    if (renderer != nullptr) {
+        SDL_DestroyRenderer(renderer);
+    }
+    if (window != nullptr) {
+        SDL_DestroyWindow(window);
+    }
+    if (SDL_WasInit(0) != 0) {
+        SDL_Quit();
+    }
+}
+
+NesError Frontend::open(const std::string &path, const Options &options)
+{
+    opts = options;
+    console = std::make_unique<Console>();
+    const NesError err = console->load(path);
+    if (err != NesError::Success) {
+        return err;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
+        fmt::print(stderr, "SDL_Init failed: {}\n", SDL_GetError());
+        return NesError::Err;
+    }
+    window = SDL_CreateWindow("nes-emu", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                              ppu::SCREEN_WIDTH * opts.scale, ppu::SCREEN_HEIGHT * opts.scale,
+                              SDL_WINDOW_RESIZABLE);
+    if (window == nullptr) {
+        fmt::print(stderr, "SDL_CreateWindow failed: {}\n", SDL_GetError());
+        return NesError::Err;
+    }
+    // Presenting waits for vsync either way, so frames never tear. No
+    // ACCELERATED flag, SDL still prefers the GPU but can fall back to the
+    // software renderer without one.
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
+    if (renderer == nullptr) {
+        fmt::print(stderr, "SDL_CreateRenderer failed: {}\n", SDL_GetError());
+        return NesError::Err;
+    }
+    SDL_RenderSetLogicalSize(renderer, ppu::SCREEN_WIDTH, ppu::SCREEN_HEIGHT);
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                ppu::SCREEN_WIDTH, ppu::SCREEN_HEIGHT);
+    if (texture == nullptr) {
+        fmt::print(stderr, "SDL_CreateTexture failed: {}\n", SDL_GetError());
+        return NesError::Err;
+    }
+
+    SDL_AudioSpec want = {};
+    want.freq = AUDIO_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 512;
+    want.callback = audio_callback;
+    want.userdata = this;
+    SDL_AudioSpec have;
+    audio = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+    if (audio == 0) {
+        if (opts.pacing == Pacing::Audio) {
+            fmt::print(stderr, "SDL_OpenAudioDevice failed: {}\n", SDL_GetError());
+            return NesError::Err;
+        }
+        // Vsync keeps the pace, the game just plays silently.
+        fmt::print(stderr, "No audio: {}\n", SDL_GetError());
+    } else {
+        console->apu().set_sample_rate(have.freq);
+    }
+    return NesError::Success;
+}
+
+NesError Frontend::run()
+{
+    running = true;
+    emulation = std::thread(&Frontend::emulate, this);
+    if (audio != 0) {
+        SDL_PauseAudioDevice(audio, 0);
+    }
+
+    while (running.load()) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT
+                    || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)) {
+                running = false;
+            }
+        }
+        poll_input();
+
+        // The palette lookup writes straight into the texture's upload
+        // buffer, only when there is a new frame.
+        if (frames.update()) {
+            void *pixels;
+            int pitch;
+            if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) == 0) {
+                ppu::to_argb(frames.front().data(), pixels, pitch);
+                SDL_UnlockTexture(texture);
+            }
+        }
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+        presented++;
+        if (opts.pacing == Pacing::Vsync) {
+            wake();
+        }
+    }
+
+    stop();
+    if (audio != 0) {
+        SDL_PauseAudioDevice(audio, 1);
+    }
+    return crashed.load() ? NesError::InvalidOpcode : NesError::Success;
+}
+
+void Frontend::stop()
+{
+    running = false;
+    wake();
+    if (emulation.joinable()) {
+        emulation.join();
+    }
+}
+
+void Frontend::emulate()
+{
+    RunAhead run_ahead(opts.run_ahead);
+    while (wait_for_frame()) {
+        console->io().set_buttons(0, buttons.load(std::memory_order_relaxed));
+        if (run_ahead.run_frame(*console) != NesError::Success) {
+            crashed = true;
+            running = false;
+            break;
+        }
+        frames_run++;
+
+        Frame &frame = frames.back();
+        std::memcpy(frame.data(), console->ppu().frame(), frame.size());
+        frames.publish();
+        push_audio();
+    }
+}
+
+bool Frontend::wait_for_frame()
+{
+    std::unique_lock<std::mutex> lock(pacing_mutex);
+    pacing.wait(lock, [this] {
+        if (!running.load()) {
+            return true;
+        }
+        if (opts.pacing == Pacing::Audio) {
+            return samples.size() < AUDIO_LATENCY;
+        }
+        return frames_run < presented.load();
+    });
+    // After a stall (window dragged around) carry on from here rather than
+    // fast-forward through the missed refreshes.
+    const uint64_t refreshes = presented.load();
+    if (opts.pacing == Pacing::Vsync && refreshes > frames_run + 1) {
+        frames_run = refreshes - 1;
+    }
+    return running.load();
+}
+
+void Frontend::wake()
+{
+    // Taking the lock orders this with the waiter's check, so the wake up
+    // can't fall between its check and its wait.
+    {
+        std::lock_guard<std::mutex> lock(pacing_mutex);
+    }
+    pacing.notify_one();
+}
+
+void Frontend::push_audio()
+{
+    int16_t buf[512];
+    size_t count;
+    while ((count = console->apu().read_samples(buf, std::size(buf))) != 0) {
+        // The device stopped taking samples, dropping them beats waiting.
+        if (samples.push(buf, count) < count) {
+            break;
+        }
+    }
+}
+
+void Frontend::poll_input()
+{
+    const uint8_t *keys = SDL_GetKeyboardState(nullptr);
+    uint8_t held = 0;
+    for (const Key &key : KEYS) {
+        if (keys[key.scancode]) {
+            held |= key.button;
+        }
+    }
+    buttons.store(held, std::memory_order_relaxed);
+}
+
+void Frontend::audio_callback(void *userdata, uint8_t *stream, int len)
+{
+    Frontend &self = *static_cast<Frontend *>(userdata);
+    int16_t *out = reinterpret_cast<int16_t *>(stream);
+    const size_t count = size_t(len) / sizeof(int16_t);
+    const size_t got = self.samples.pop(out, count);
+    // Underrun, play silence rather than garbage.
+    std::fill(out + got, out + count, int16_t(0));
+    if (self.opts.pacing == Pacing::Audio) {
+        self.wake();
+    }
+}
+
+}   // Namespace frontend.
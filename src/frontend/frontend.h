@@ -0,0 +1,104 @@
+// frontend.h : The windowed player. Emulation runs on a thread of its own and
+// hands finished frames to the render thread through a triple buffer, so
+// neither ever waits for the other to finish a frame.
+//
+#pragma once
+
+#include "console.h"
+#include "nes-error.h"
+#include "ppu/ppu.h"
+#include "spsc-ring.h"
+#include "triple-buffer.h"
+
+#include <SDL.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace frontend {
+
+/// What sets the emulation speed.
+enum class Pacing {
+    Vsync,  // One frame per display refresh, for 60 Hz displays.
+    Audio,  // As fast as the audio device drains the sample queue.
+};
+
+struct Options {
+    Pacing pacing = Pacing::Vsync;
+    int scale = 3;      // Initial window size in multiples of 256x240.
+    unsigned run_ahead = 0;     // Frames of run-ahead, see RunAhead.
+};
+
+class Frontend {
+public:
+    Frontend();
+    Frontend(const Frontend&) = delete;
+    Frontend &operator=(const Frontend&) = delete;
+    /// Stops the emulation thread and closes the window.
+    ~Frontend();
+
+    /// Loads the cartridge at path and opens the window and audio device.
+    /// Returns the error of Console::load(), or Err if SDL fails, with the
+    /// reason printed.
+    NesError open(const std::string &path, const Options &options);
+    /// Plays until the window is closed or Escape is pressed. Call from the
+    /// thread that called open(). Returns InvalidOpcode if the game crashed
+    /// the CPU.
+    NesError run();
+
+private:
+    using Frame = std::array<uint8_t, ppu::SCREEN_WIDTH * ppu::SCREEN_HEIGHT>;
+
+    static constexpr int AUDIO_RATE = 48000;
+    // Samples the emulation thread keeps queued when pacing by audio, two
+    // frames' worth.
+    static constexpr size_t AUDIO_LATENCY = 1600;
+
+    /// Body of the emulation thread.
+    void emulate();
+    /// Blocks the emulation thread until pacing allows another frame.
+    /// Returns false once it should stop instead.
+    bool wait_for_frame();
+    /// Makes the emulation thread check pacing again.
+    void wake();
+    /// Queues the APU's samples of the last frame for the audio device.
+    void push_audio();
+    /// Reads the keyboard into buttons.
+    void poll_input();
+    /// Joins the emulation thread.
+    void stop();
+
+    static void audio_callback(void *userdata, uint8_t *stream, int len);
+
+    Options opts;
+    std::unique_ptr<Console> console;
+
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    // 256x240 ARGB8888 streaming texture the frames are converted into.
+    SDL_Texture *texture;
+    SDL_AudioDeviceID audio;
+
+    std::thread emulation;
+    TripleBuffer<Frame> frames;
+    SpscRing<int16_t> samples;
+
+    // Written by the render thread.
+    std::atomic<bool> running;
+    std::atomic<uint8_t> buttons;
+    std::atomic<uint64_t> presented;
+    // Written by the emulation thread.
+    std::atomic<bool> crashed;
+    uint64_t frames_run;
+
+    std::mutex pacing_mutex;
+    std::condition_variable pacing;
+};
+
+}   // Namespace frontend.
@@ -0,0 +1,102 @@
+// io.cpp
+//
+#include "io.h"
+#include "apu/apu.h"
+#include "cpu/cpu.h"
+#include "ppu/ppu.h"
+
+namespace io {
+
+Registers::Registers()
+{
+    apu = nullptr;
+    bus = nullptr;
+    ppu = nullptr;
+    cpu = nullptr;
+    held[0] = held[1] = 0x00;
+    shift[0] = shift[1] = 0x00;
+    strobe = false;
+}
+
+uint8_t Registers::read(uint16_t addr)
+{
+    if (addr > LAST) {
+        return uint8_t(addr >> 8);
+    }
+    if (addr == JOY1 || addr == JOY2) {
+        const int port = addr - JOY1;
+        if (strobe) {
+            shift[port] = held[port];
+        }
+        const uint8_t bit = shift[port] & 0x01;
+        // Standard controllers return 1 once all 8 buttons are out.
+        if (!strobe) {
+            shift[port] = uint8_t(0x80 | (shift[port] >> 1));
+        }
+        // The upper bits are open bus, the high byte of the address.
+        return uint8_t(0x40 | bit);
+    }
+    if (addr == APU_STATUS && apu != nullptr) {
+        return apu->read_status();
+    }
+    // The rest is write-only.
+    return uint8_t(addr >> 8);
+}
+
+void Registers::write(uint16_t addr, uint8_t val)
+{
+    if (addr > LAST) {
+        return;
+    }
+    if (addr == JOY1) {
+        strobe = val & 0x01;
+        if (strobe) {
+            shift[0] = held[0];
+            shift[1] = held[1];
+        }
+    } else if (addr == OAM_DMA) {
+        oam_dma(val);
+    } else if (addr <= JOY2 && apu != nullptr) {
+        // $4017 writes go to the APU's frame sequencer.
+        apu->write(addr, val);
+    }
+}
+
+void Registers::oam_dma(uint8_t page)
+{
+    if (ppu == nullptr) {
+        return;
+    }
+    const uint16_t addr = uint16_t(page << 8);
+    const uint8_t *src = (bus != nullptr) ? bus->read_page(addr) : nullptr;
+    if (src != nullptr) {
+        ppu->oam_dma(src);
+    } else {
+        // Device pages have to be read byte by byte, only odd code copies
+        // sprites from registers or open bus.
+        uint8_t copy[256];
+        for (int i = 0; i < 256; i++) {
+            copy[i] = (bus != nullptr) ? bus->read(uint16_t(addr | i)) : page;
+        }
+        ppu->oam_dma(copy);
+    }
+    if (cpu != nullptr) {
+        // One cycle to halt, one more to line up with a read cycle if the
+        // write landed on an odd one, then 256 reads and 256 writes.
+        cpu->stall(513 + uint32_t(cpu->bus_cycle() & 1));
+    }
+}
+
+void Registers::save_state(state::Writer &state) const
+{
+    state.bytes(shift, sizeof(shift));
+    state.value(strobe);
+}
+
+void Registers::load_state(state::Reader &state)
+{
+    state.bytes(shift, sizeof(shift));
+    state.value(strobe);
+}
+
+}   // Namespace io.
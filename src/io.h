@@ -0,0 +1,85 @@
+// io.h : APU and I/O registers ($4000-$401F).
+//
+#pragma once
+
+#include "bus.h"
+#include "state.h"
+
+#include <cstdint>
+
+namespace apu {
+class APU;
+}
+namespace cpu {
+class CPU;
+}
+namespace ppu {
+class PPU;
+}
+
+namespace io {
+
+// Buttons of a standard controller for Registers::set_buttons(), in the order
+// the controller reports them.
+static constexpr uint8_t BUTTON_A      = 1 << 0;
+static constexpr uint8_t BUTTON_B      = 1 << 1;
+static constexpr uint8_t BUTTON_SELECT = 1 << 2;
+static constexpr uint8_t BUTTON_START  = 1 << 3;
+static constexpr uint8_t BUTTON_UP     = 1 << 4;
+static constexpr uint8_t BUTTON_DOWN   = 1 << 5;
+static constexpr uint8_t BUTTON_LEFT   = 1 << 6;
+static constexpr uint8_t BUTTON_RIGHT  = 1 << 7;
+
+/// Handles CPU page $40. $4000-$401F hold the APU and I/O registers, the rest
+/// of the page belongs to the cartridge and reads as open bus.
+class Registers : public bus::Device {
+public:
+    Registers();
+    ~Registers() = default;
+
+    uint8_t read(uint16_t addr) override;
+    void write(uint16_t addr, uint8_t val) override;
+
+    /// APU the sound registers and $4015 go to, may be nullptr.
+    inline void set_apu(apu::APU *apu) { this->apu = apu; }
+    /// Where OAM DMA ($4014) copies from and to, and the CPU it stalls.
+    /// Without a PPU $4014 does nothing.
+    inline void set_dma(bus::Bus *bus, ppu::PPU *ppu, cpu::CPU *cpu)
+    {
+        this->bus = bus;
+        this->ppu = ppu;
+        this->cpu = cpu;
+    }
+
+    /// Sets the buttons held on the standard controller in port 0 ($4016) or
+    /// 1 ($4017), BUTTON_* flags. The game sees them on its next strobe.
+    inline void set_buttons(int port, uint8_t buttons) { held[port & 1] = buttons; }
+
+    void save_state(state::Writer &state) const;
+    void load_state(state::Reader &state);
+
+private:
+    static constexpr uint16_t FIRST = 0x4000;
+    static constexpr uint16_t LAST  = 0x401f;
+
+    static constexpr uint16_t OAM_DMA    = 0x4014;
+    static constexpr uint16_t APU_STATUS = 0x4015;
+    static constexpr uint16_t JOY1       = 0x4016;
+    static constexpr uint16_t JOY2       = 0x4017;
+
+    /// Copies page XX00-XXFF to OAM and stalls the CPU for it.
+    void oam_dma(uint8_t page);
+
+    apu::APU *apu;
+    bus::Bus *bus;
+    ppu::PPU *ppu;
+    cpu::CPU *cpu;
+
+    // Buttons held on each controller, and its shift register. Writing 1 to
+    // $4016 holds the shift registers at the buttons until 0 is written.
+    uint8_t held[2];
+    uint8_t shift[2];
+    bool strobe;
+};
+
+}   // Namespace io.
@@ -0,0 +1,105 @@
+// mapped-file.cpp
+//
+#include "mapped-file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+NesError MappedFile::open(const std::string &path)
+{
+    close();
+
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) {
+        return NesError::CouldNotOpenFile;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(f, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(f);
+        return NesError::CouldNotOpenFile;
+    }
+    HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m == nullptr) {
+        CloseHandle(f);
+        return NesError::CouldNotOpenFile;
+    }
+    const void *view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(m);
+        CloseHandle(f);
+        return NesError::CouldNotOpenFile;
+    }
+
+    file    = f;
+    mapping = m;
+    bytes   = static_cast<const uint8_t *>(view);
+    length  = size_t(file_size.QuadPart);
+    return NesError::Success;
+}
+
+void MappedFile::close()
+{
+    if (bytes != nullptr) {
+        UnmapViewOfFile(bytes);
+        CloseHandle(mapping);
+        CloseHandle(file);
+    }
+    bytes   = nullptr;
+    length  = 0;
+    file    = nullptr;
+    mapping = nullptr;
+}
+
+#else
+
+NesError MappedFile::open(const std::string &path)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return NesError::CouldNotOpenFile;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return NesError::CouldNotOpenFile;
+    }
+    void *view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return NesError::CouldNotOpenFile;
+    }
+
+    bytes  = static_cast<const uint8_t *>(view);
+    length = size_t(st.st_size);
+    return NesError::Success;
+}
+
+void MappedFile::close()
+{
+    if (bytes != nullptr) {
+        munmap(const_cast<uint8_t *>(bytes), length);
+    }
+    bytes  = nullptr;
+    length = 0;
+}
+
+#endif
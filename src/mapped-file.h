@@ -0,0 +1,35 @@
+// mapped-file.h : Read-only memory mapping of a whole file.
+//
+#pragma once
+
+#include "nes-error.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    /// Maps the file at path, unmapping any file mapped before.
+    /// Returns CouldNotOpenFile if the file can't be opened or mapped.
+    NesError open(const std::string &path);
+
+    /// Unmaps the file. Pointers from data() are invalid afterwards.
+    void close();
+
+    inline const uint8_t *data() const { return bytes; }
+    inline size_t size() const { return length; }
+
+private:
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
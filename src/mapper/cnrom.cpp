@@ -0,0 +1,35 @@
+// cnrom.cpp
+//
+#include "mapper/cnrom.h"
+
+namespace mapper {
+
+void Cnrom::reset()
+{
+    bank = 0x00;
+    map_prg(0x8000, 32 * 1024, 0);
+    map_chr(0, 8, bank);
+}
+
+void Cnrom::write(uint16_t addr, uint8_t val)
+{
+    if (addr >= 0x8000) {   // Bank select.
+        bank = val;
+        map_chr(0, 8, bank);
+    }
+}
+
+void Cnrom::save_state(state::Writer &state) const
+{
+    Mapper::save_state(state);
+    state.value(bank);
+}
+
+void Cnrom::load_state(state::Reader &state)
+{
+    Mapper::load_state(state);
+    state.value(bank);
+    map_chr(0, 8, bank);
+}
+
+}   // Namespace mapper.
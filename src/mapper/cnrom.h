@@ -0,0 +1,22 @@
+// cnrom.h : Mapper 3. Fixed PRG ROM, switchable 8kB CHR ROM bank.
+//
+#pragma once
+
+#include "mapper/mapper.h"
+
+namespace mapper {
+
+class Cnrom : public Mapper {
+public:
+    using Mapper::Mapper;
+
+    void reset() override;
+    void write(uint16_t addr, uint8_t val) override;
+    void save_state(state::Writer &state) const override;
+    void load_state(state::Reader &state) override;
+
+private:
+    uint8_t bank = 0x00;    // 8kB CHR bank.
+};
+
+}   // Namespace mapper.
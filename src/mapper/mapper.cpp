@@ -0,0 +1,145 @@
+// mapper.cpp
+//
+#include "mapper/mapper.h"
+#include "mapper/cnrom.h"
+#include "mapper/mmc1.h"
+#include "mapper/mmc3.h"
+#include "mapper/nrom.h"
+#include "mapper/uxrom.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace mapper {
+
+Mapper::Mapper(const Cartridge &cart, bus::Bus &bus, ppu::PPU &ppu)
+    : cart(cart), bus(bus), ppu(ppu), irq_line(false), interrupts(nullptr)
+{
+    const CartridgeHeader &header = cart.header();
+
+    // Most boards without a size in the header still have 8kB at $6000.
+    const size_t prg_ram_size = std::max<size_t>(
+        header.prg_ram_size + header.prg_nvram_size, 8 * 1024);
+    prg_ram.assign(prg_ram_size, 0x00);
+    if (cart.trainer() != nullptr) {
+        // The trainer lives at $7000.
+        std::memcpy(&prg_ram[0x1000], cart.trainer(), Cartridge::TRAINER_SIZE);
+    }
+
+    if (cart.chr_rom() == nullptr) {
+        const size_t chr_ram_size = std::max<size_t>(
+            header.chr_ram_size + header.chr_nvram_size, 8 * 1024);
+        chr_ram.assign(chr_ram_size, 0x00);
+        ppu.set_chr_memory(chr_ram.data(), chr_ram.size());
+    } else {
+        ppu.set_chr_memory(cart.chr_rom(), cart.chr_rom_size());
+    }
+
+    bus.map_device(0x41, 0x1f, this);
+    bus.map_memory(0x60, 0x20, prg_ram.data(), std::min<size_t>(prg_ram.size(), 8 * 1024));
+    bus.map_device(0x80, 0x80, this);
+    ppu.set_mirroring(cart.mirroring());
+}
+
+uint8_t Mapper::read(uint16_t addr)
+{
+    // Nothing on the board answers, leaving the high byte on the bus.
+    return uint8_t(addr >> 8);
+}
+
+void Mapper::save_state(state::Writer &state) const
+{
+    state.bytes(prg_ram.data(), prg_ram.size());
+    state.bytes(chr_ram.data(), chr_ram.size());
+    state.value(irq_line);
+}
+
+void Mapper::load_state(state::Reader &state)
+{
+    state.bytes(prg_ram.data(), prg_ram.size());
+    if (!chr_ram.empty()) {
+        // Restores often come back to nearly the same CHR RAM (run-ahead
+        // does one every frame), so only changed tiles get decoded again.
+        const uint8_t *saved = state.view(chr_ram.size());
+        if (saved == nullptr) {
+            std::fill(chr_ram.begin(), chr_ram.end(), uint8_t(0));
+            ppu.invalidate_tiles();
+        } else {
+            for (size_t offset = 0; offset < chr_ram.size(); offset += 16) {
+                if (std::memcmp(&chr_ram[offset], &saved[offset], 16) != 0) {
+                    std::memcpy(&chr_ram[offset], &saved[offset], 16);
+                    ppu.invalidate_tile(offset);
+                }
+            }
+        }
+    }
+    state.value(irq_line);
+}
+
+void Mapper::map_prg(uint16_t addr, size_t size, int bank)
+{
+    // PRG smaller than the window is mirrored across it, which needs at least
+    // a page. Cartridge::load() only lets through whole 8kB banks.
+    if (cart.prg_rom_size() < bus::Bus::PAGE_SIZE) {
+        return;
+    }
+    const int count = int(std::max<size_t>(cart.prg_rom_size() / size, 1));
+    bank %= count;
+    if (bank < 0) {
+        bank += count;
+    }
+    const size_t bank_size = std::min(size, cart.prg_rom_size());
+    bus.map_read(uint8_t(addr >> 8), size / bus::Bus::PAGE_SIZE,
+                 cart.prg_rom() + size_t(bank) * bank_size, bank_size);
+}
+
+void Mapper::map_chr(int slot, int kb, int bank)
+{
+    const size_t chr_size = (cart.chr_rom() != nullptr) ? cart.chr_rom_size() : chr_ram.size();
+    const int count = int(chr_size / 1024);
+    // Cartridge::load() only lets through whole 1kB banks of CHR ROM.
+    if (count == 0) {
+        return;
+    }
+    for (int i = 0; i < kb; i++) {
+        int index = (bank * kb + i) % count;
+        if (index < 0) {
+            index += count;
+        }
+        if (cart.chr_rom() != nullptr) {
+            ppu.map_chr(slot + i, cart.chr_rom() + size_t(index) * 1024);
+        } else {
+            ppu.map_chr_ram(slot + i, &chr_ram[size_t(index) * 1024]);
+        }
+    }
+}
+
+void Mapper::set_irq(bool level)
+{
+    irq_line = level;
+    if (interrupts != nullptr) {
+        interrupts->set_irq(cpu::IrqSource::Mapper, level);
+    }
+}
+
+NesError create(const Cartridge &cart, bus::Bus &bus, ppu::PPU &ppu,
+                std::unique_ptr<Mapper> &mapper)
+{
+    switch (cart.mapper()) {
+    case 0: mapper = std::make_unique<Nrom>(cart, bus, ppu); break;
+    case 1: mapper = std::make_unique<Mmc1>(cart, bus, ppu); break;
+    case 2: mapper = std::make_unique<Uxrom>(cart, bus, ppu); break;
+    case 3: mapper = std::make_unique<Cnrom>(cart, bus, ppu); break;
+    case 4: mapper = std::make_unique<Mmc3>(cart, bus, ppu); break;
+    default:
+        fmt::print(stderr, "Mapper {} is not supported.\n", cart.mapper());
+        return NesError::UnsupportedMapper;
+    }
+    mapper->reset();
+    ppu.set_mapper(mapper.get());
+    return NesError::Success;
+}
+
+}   // Namespace mapper.
@@ -0,0 +1,81 @@
+// mapper.h : Cartridge boards. A mapper owns the cartridge's RAM and switches
+// banks by repointing bus and PPU pages, no bank data is ever copied.
+//
+#pragma once
+
+#include "bus.h"
+#include "cartridge.h"
+#include "cpu/interrupts.h"
+#include "nes-error.h"
+#include "ppu/ppu.h"
+#include "state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mapper {
+
+/// Base of all mappers. Handles $4020-$FFFF: PRG RAM at $6000 is plain bus
+/// memory, PRG ROM reads go straight to the mapped banks and only writes to
+/// $8000-$FFFF (the bank registers) reach write().
+class Mapper : public bus::Device {
+public:
+    Mapper(const Cartridge &cart, bus::Bus &bus, ppu::PPU &ppu);
+    virtual ~Mapper() = default;
+
+    /// Maps the power-up banks. Called once by create().
+    virtual void reset() = 0;
+
+    /// Reads from $4020-$7FFF that aren't PRG RAM.
+    uint8_t read(uint16_t addr) override;
+
+    /// Clocked once per rendered scanline by the PPU. Used by boards that
+    /// count scanlines for IRQs.
+    virtual void scanline() {}
+    /// True for boards whose scanline() does something. The PPU only stops
+    /// at the scanline clock for them.
+    virtual bool counts_scanlines() const { return false; }
+
+    /// True while the board holds its IRQ line low.
+    inline bool irq() const { return irq_line; }
+    /// Interrupt lines the board's IRQ drives, may be nullptr.
+    inline void set_interrupts(cpu::Interrupts *interrupts) { this->interrupts = interrupts; }
+
+    /// Appends the board's RAM and registers to state. Boards with registers
+    /// add them after the base class' part.
+    virtual void save_state(state::Writer &state) const;
+    /// Reads back what save_state() wrote. Boards map the banks their
+    /// registers select again afterwards.
+    virtual void load_state(state::Reader &state);
+
+protected:
+    /// Maps PRG ROM bank of given size (multiple of 256 bytes) at addr.
+    /// Negative banks count from the last bank, banks past the end wrap.
+    void map_prg(uint16_t addr, size_t size, int bank);
+
+    /// Maps CHR bank of size kb kilobytes into pattern table slots starting at
+    /// slot. Negative banks count from the last bank, banks past the end wrap.
+    void map_chr(int slot, int kb, int bank);
+    /// Pulls (true) or releases the IRQ line.
+    void set_irq(bool level);
+
+    const Cartridge &cart;
+    bus::Bus &bus;
+    ppu::PPU &ppu;
+
+    std::vector<uint8_t> prg_ram;
+    // Only used if the cartridge has no CHR ROM.
+    std::vector<uint8_t> chr_ram;
+
+    bool irq_line;
+    cpu::Interrupts *interrupts;
+};
+
+/// Creates the mapper the cartridge's header asks for and maps its banks.
+/// Returns UnsupportedMapper if there is no implementation for it.
+NesError create(const Cartridge &cart, bus::Bus &bus, ppu::PPU &ppu,
+                std::unique_ptr<Mapper> &mapper);
+
+}   // Namespace mapper.
@@ -0,0 +1,104 @@
+// mmc1.cpp
+//
+#include "mapper/mmc1.h"
+
+// Register layout taken from:
+// https://wiki.nesdev.com/w/index.php/MMC1
+
+namespace mapper {
+
+void Mmc1::reset()
+{
+    shift = SHIFT_RESET;
+    // Power up in PRG mode 3 so the reset vector is in the fixed last bank.
+    control = 0x0c;
+    chr_bank0 = chr_bank1 = prg_bank = 0x00;
+    update_banks();
+}
+
+void Mmc1::write(uint16_t addr, uint8_t val)
+{
+    if (addr < 0x8000) {
+        return;
+    }
+
+    if (val & 0x80) {   // Reset shift register.
+        shift = SHIFT_RESET;
+        control |= 0x0c;
+        update_banks();
+        return;
+    }
+
+    const bool full = shift & 0x01;
+    shift = (shift >> 1) | ((val & 0x01) << 4);
+    if (!full) {
+        return;
+    }
+
+    switch ((addr >> 13) & 0x03) {
+    case 0: control   = shift; break;   // $8000-$9FFF
+    case 1: chr_bank0 = shift; break;   // $A000-$BFFF
+    case 2: chr_bank1 = shift; break;   // $C000-$DFFF
+    case 3: prg_bank  = shift; break;   // $E000-$FFFF
+    }
+    shift = SHIFT_RESET;
+    update_banks();
+}
+
+void Mmc1::save_state(state::Writer &state) const
+{
+    Mapper::save_state(state);
+    state.value(shift);
+    state.value(control);
+    state.value(chr_bank0);
+    state.value(chr_bank1);
+    state.value(prg_bank);
+}
+
+void Mmc1::load_state(state::Reader &state)
+{
+    Mapper::load_state(state);
+    state.value(shift);
+    state.value(control);
+    state.value(chr_bank0);
+    state.value(chr_bank1);
+    state.value(prg_bank);
+    update_banks();
+}
+
+void Mmc1::update_banks()
+{
+    static constexpr Mirroring mirrorings[] = {
+        Mirroring::SingleLower,
+        Mirroring::SingleUpper,
+        Mirroring::Vertical,
+        Mirroring::Horizontal,
+    };
+    ppu.set_mirroring(mirrorings[control & 0x03]);
+
+    // 512kB boards (SUROM) pick the 256kB half with CHR bank 0 bit 4.
+    const int outer = (cart.prg_rom_size() > 256 * 1024) ? (chr_bank0 & 0x10) : 0;
+    const int bank = outer | (prg_bank & 0x0f);
+    switch ((control >> 2) & 0x03) {
+    case 0: case 1:     // Switch 32kB at $8000, ignoring the low bit.
+        map_prg(0x8000, 32 * 1024, bank >> 1);
+        break;
+    case 2:             // First bank fixed at $8000, switch $C000.
+        map_prg(0x8000, 16 * 1024, outer);
+        map_prg(0xc000, 16 * 1024, bank);
+        break;
+    case 3:             // Switch $8000, last bank fixed at $C000.
+        map_prg(0x8000, 16 * 1024, bank);
+        map_prg(0xc000, 16 * 1024, outer | 0x0f);
+        break;
+    }
+
+    if (control & 0x10) {   // Two separate 4kB banks.
+        map_chr(0, 4, chr_bank0);
+        map_chr(4, 4, chr_bank1);
+    } else {                // One 8kB bank, ignoring the low bit.
+        map_chr(0, 8, chr_bank0 >> 1);
+    }
+}
+
+}   // Namespace mapper.
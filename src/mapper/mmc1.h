@@ -0,0 +1,34 @@
+// mmc1.h : Mapper 1 (SxROM). Registers are loaded one bit at a time through
+// a 5 bit shift register.
+//
+#pragma once
+
+#include "mapper/mapper.h"
+
+namespace mapper {
+
+class Mmc1 : public Mapper {
+public:
+    using Mapper::Mapper;
+
+    void reset() override;
+    void write(uint16_t addr, uint8_t val) override;
+    void save_state(state::Writer &state) const override;
+    void load_state(state::Reader &state) override;
+
+private:
+    /// Maps banks according to the current register values.
+    void update_banks();
+
+    // Bit 4 marks how far the shift register is filled. Once it reaches bit 0
+    // the fifth write copies it into a register.
+    static constexpr uint8_t SHIFT_RESET = 0x10;
+
+    uint8_t shift = SHIFT_RESET;
+    uint8_t control = 0x0c;     // CPPMM: CHR mode, PRG mode, mirroring.
+    uint8_t chr_bank0 = 0x00;
+    uint8_t chr_bank1 = 0x00;
+    uint8_t prg_bank = 0x00;
+};
+
+}   // Namespace mapper.
@@ -0,0 +1,121 @@
+// mmc3.cpp
+//
+#include "mapper/mmc3.h"
+
+// Register layout taken from:
+// https://wiki.nesdev.com/w/index.php/MMC3
+
+namespace mapper {
+
+void Mmc3::reset()
+{
+    bank_select = 0x00;
+    for (int i = 0; i < 8; i++) {
+        banks[i] = 0x00;
+    }
+    irq_latch = irq_counter = 0x00;
+    irq_reload = irq_enabled = false;
+    set_irq(false);
+    update_banks();
+}
+
+void Mmc3::write(uint16_t addr, uint8_t val)
+{
+    if (addr < 0x8000) {
+        return;
+    }
+
+    const bool even = (addr & 0x0001) == 0;
+    switch (addr & 0xe000) {
+    case 0x8000:
+        if (even) {     // Bank select.
+            bank_select = val;
+        } else {        // Bank data.
+            banks[bank_select & 0x07] = val;
+        }
+        update_banks();
+        break;
+    case 0xa000:
+        if (even && cart.mirroring() != Mirroring::FourScreen) {
+            ppu.set_mirroring((val & 0x01) ? Mirroring::Horizontal : Mirroring::Vertical);
+        }
+        // Odd: PRG RAM protect, not emulated.
+        break;
+    case 0xc000:
+        if (even) {     // IRQ latch.
+            irq_latch = val;
+        } else {        // IRQ reload.
+            irq_counter = 0;
+            irq_reload = true;
+        }
+        break;
+    case 0xe000:
+        if (even) {     // IRQ disable, also acknowledges a pending IRQ.
+            irq_enabled = false;
+            set_irq(false);
+        } else {        // IRQ enable.
+            irq_enabled = true;
+        }
+        break;
+    }
+}
+
+void Mmc3::scanline()
+{
+    if (irq_counter == 0 || irq_reload) {
+        irq_counter = irq_latch;
+        irq_reload = false;
+    } else {
+        irq_counter--;
+    }
+    if (irq_counter == 0 && irq_enabled) {
+        set_irq(true);
+    }
+}
+
+void Mmc3::save_state(state::Writer &state) const
+{
+    Mapper::save_state(state);
+    state.value(bank_select);
+    state.bytes(banks, sizeof(banks));
+    state.value(irq_latch);
+    state.value(irq_counter);
+    state.value(irq_reload);
+    state.value(irq_enabled);
+}
+
+void Mmc3::load_state(state::Reader &state)
+{
+    // Mirroring is restored by the PPU.
+    Mapper::load_state(state);
+    state.value(bank_select);
+    state.bytes(banks, sizeof(banks));
+    state.value(irq_latch);
+    state.value(irq_counter);
+    state.value(irq_reload);
+    state.value(irq_enabled);
+    update_banks();
+}
+
+void Mmc3::update_banks()
+{
+    // R0/R1 are 2kB banks, R2-R5 1kB banks. Inversion swaps the halves.
+    const int low  = (bank_select & 0x80) ? 4 : 0;
+    const int high = low ^ 4;
+    map_chr(low + 0, 2, banks[0] >> 1);
+    map_chr(low + 2, 2, banks[1] >> 1);
+    map_chr(high + 0, 1, banks[2]);
+    map_chr(high + 1, 1, banks[3]);
+    map_chr(high + 2, 1, banks[4]);
+    map_chr(high + 3, 1, banks[5]);
+
+    // $A000 is always R7 and $E000 the last bank. PRG mode swaps R6 and the
+    // second to last bank between $8000 and $C000.
+    const bool swap = bank_select & 0x40;
+    map_prg(0x8000, 8 * 1024, swap ? -2 : banks[6] & 0x3f);
+    map_prg(0xa000, 8 * 1024, banks[7] & 0x3f);
+    map_prg(0xc000, 8 * 1024, swap ? banks[6] & 0x3f : -2);
+    map_prg(0xe000, 8 * 1024, -1);
+}
+
+}   // Namespace mapper.
@@ -0,0 +1,34 @@
+// mmc3.h : Mapper 4 (TxROM). 8kB PRG and 1kB/2kB CHR banks plus a scanline
+// counter that raises IRQs.
+//
+#pragma once
+
+#include "mapper/mapper.h"
+
+namespace mapper {
+
+class Mmc3 : public Mapper {
+public:
+    using Mapper::Mapper;
+
+    void reset() override;
+    void write(uint16_t addr, uint8_t val) override;
+    void save_state(state::Writer &state) const override;
+    void load_state(state::Reader &state) override;
+    void scanline() override;
+    bool counts_scanlines() const override { return true; }
+
+private:
+    /// Maps banks according to the current register values.
+    void update_banks();
+
+    uint8_t bank_select = 0x00;     // CP... .RRR: CHR inversion, PRG mode, register.
+    uint8_t banks[8] = {};          // R0-R7.
+
+    uint8_t irq_latch = 0x00;
+    uint8_t irq_counter = 0x00;
+    bool irq_reload = false;
+    bool irq_enabled = false;
+};
+
+}   // Namespace mapper.
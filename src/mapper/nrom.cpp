@@ -0,0 +1,19 @@
+// nrom.cpp
+//
+#include "mapper/nrom.h"
+
+namespace mapper {
+
+void Nrom::reset()
+{
+    // 16kB carts are mirrored at $C000.
+    map_prg(0x8000, 32 * 1024, 0);
+    map_chr(0, 8, 0);
+}
+
+void Nrom::write(uint16_t, uint8_t)
+{
+    // No registers.
+}
+
+}   // Namespace mapper.
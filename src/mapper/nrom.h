@@ -0,0 +1,17 @@
+// nrom.h : Mapper 0. 16kB or 32kB PRG ROM and 8kB CHR, no bank switching.
+//
+#pragma once
+
+#include "mapper/mapper.h"
+
+namespace mapper {
+
+class Nrom : public Mapper {
+public:
+    using Mapper::Mapper;
+
+    void reset() override;
+    void write(uint16_t addr, uint8_t val) override;
+};
+
+}   // Namespace mapper.
@@ -0,0 +1,36 @@
+// uxrom.cpp
+//
+#include "mapper/uxrom.h"
+
+namespace mapper {
+
+void Uxrom::reset()
+{
+    bank = 0x00;
+    map_prg(0x8000, 16 * 1024, bank);
+    map_prg(0xc000, 16 * 1024, -1);
+    map_chr(0, 8, 0);
+}
+
+void Uxrom::write(uint16_t addr, uint8_t val)
+{
+    if (addr >= 0x8000) {   // Bank select.
+        bank = val;
+        map_prg(0x8000, 16 * 1024, bank);
+    }
+}
+
+void Uxrom::save_state(state::Writer &state) const
+{
+    Mapper::save_state(state);
+    state.value(bank);
+}
+
+void Uxrom::load_state(state::Reader &state)
+{
+    Mapper::load_state(state);
+    state.value(bank);
+    map_prg(0x8000, 16 * 1024, bank);
+}
+
+}   // Namespace mapper.
@@ -0,0 +1,23 @@
+// uxrom.h : Mapper 2. Switchable 16kB PRG bank at $8000, last bank fixed at
+// $C000, 8kB CHR RAM.
+//
+#pragma once
+
+#include "mapper/mapper.h"
+
+namespace mapper {
+
+class Uxrom : public Mapper {
+public:
+    using Mapper::Mapper;
+
+    void reset() override;
+    void write(uint16_t addr, uint8_t val) override;
+    void save_state(state::Writer &state) const override;
+    void load_state(state::Reader &state) override;
+
+private:
+    uint8_t bank = 0x00;    // 16kB bank at $8000.
+};
+
+}   // Namespace mapper.
@@ -8,4 +8,8 @@ enum class NesError {
     BadAlloc,
     CouldNotOpenFile,
     InvalidOpcode,
+    InvalidRom,
+    UnsupportedMapper,
+    InvalidState,
+    BufferTooSmall,
 };
\ No newline at end of file
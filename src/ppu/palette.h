@@ -0,0 +1,18 @@
+// palette.h : Colors of the PPU's 64 palette indices, for turning frame()
+// into pixels.
+//
+#pragma once
+
+#include <cstdint>
+
+namespace ppu {
+
+/// 0xAARRGGBB of palette indices $00-$3F as a 2C02 outputs them. Emphasis and
+/// greyscale aren't applied.
+extern const uint32_t PALETTE[64];
+
+/// Converts a frame of palette indices (PPU::frame()) to ARGB8888 pixels.
+/// Rows start pitch bytes apart, as in a locked SDL texture.
+void to_argb(const uint8_t *frame, void *pixels, int pitch);
+
+}   // Namespace ppu.
@@ -1,97 +1,676 @@
 // ppu.cpp
 //
 #include "ppu/ppu.h"
+#include "cpu/cpu.h"
+#include "mapper/mapper.h"
 #include "nes-utils.h"
 
+#include <algorithm>
+#include <cstring>
+
 // Detailed comments taken from:
 // http://wiki.nesdev.com/w/index.php/PPU_programmer_reference
 
 namespace ppu {
 
-PPU::PPU(uint8_t ram[], uint8_t vram[])
-{
-    ppu_ctrl    = &ram[0x2000];
-    ppu_mask    = &ram[0x2001];
-    ppu_status  = &ram[0x2002];
-    oam_addr    = &ram[0x2003];
-    oam_data    = &ram[0x2004];
-    ppu_scroll  = &ram[0x2005];
-    ppu_addr    = &ram[0x2006];
-    ppu_data    = &ram[0x2007];
-    oam_dma     = &ram[0x4014];
-
-    *ppu_ctrl    = 0x00;
-    *ppu_mask    = 0x00;
-    *ppu_status  = 0xa0;
-    *oam_addr    = 0x00;
-    *oam_data    = 0x00;
-    *ppu_scroll  = 0x00;
-    *ppu_addr    = 0x00;
-    *ppu_data    = 0x00;
-    *oam_dma     = 0x00;
-
-    // vram = std::make_unique<uint8_t[]>(16 * 1024);
-    this->vram = vram;
+PPU::PPU()
+{
+    current_addr = 0x0000;
+    tmp_addr     = 0x0000;
+    finex_scroll = 0x00;
+    write_toggle = false;
+
+    ppu_ctrl    = 0x00;
+    ppu_mask    = 0x00;
+    ppu_status  = 0xa0;
+    oam_addr    = 0x00;
+    io_latch    = 0x00;
+    data_buffer = 0x00;
+
+    current_scanline = 0;
+    current_dot      = 0;
+    odd_frame        = false;
+    frames           = 0;
+    sprite0_hit_dot  = -1;
+    output           = true;
+    sprite_count     = 0;
+    mapper           = nullptr;
+    cpu              = nullptr;
+    interrupts       = nullptr;
+#if NES_PROFILE
+    profiler         = nullptr;
+#endif
+    cpu_cycle        = 0;
+
     oam = std::make_unique<uint8_t[]>(256);
+    framebuffer = std::make_unique<uint8_t[]>(SCREEN_WIDTH * SCREEN_HEIGHT);
+    for (auto &color : palette) {
+        color = 0x00;
+    }
+    for (auto &byte : ciram) {
+        byte = 0x00;
+    }
+    // Until a cartridge maps something the pattern tables read nametable RAM.
+    for (int slot = 0; slot < 8; slot++) {
+        chr_pages[slot] = ciram;
+        chr_write_pages[slot] = nullptr;
+        chr_tiles[slot] = -1;
+    }
+    set_mirroring(Mirroring::Horizontal);
+    event_cycle = find_next_event();
+}
+
+void PPU::save_state(state::Writer &state) const
+{
+    state.value(current_addr);
+    state.value(tmp_addr);
+    state.value(finex_scroll);
+    state.value(write_toggle);
+    state.value(ppu_ctrl);
+    state.value(ppu_mask);
+    state.value(ppu_status);
+    state.value(oam_addr);
+    state.value(io_latch);
+    state.value(data_buffer);
+    state.value(current_scanline);
+    state.value(current_dot);
+    state.value(odd_frame);
+    state.value(frames);
+    state.value(sprite0_hit_dot);
+    state.value(cpu_cycle);
+
+    // Mirroring as the nametable RAM bank behind each nametable.
+    for (const uint8_t *nametable : nametables) {
+        state.value(uint8_t((nametable - ciram) / 1024));
+    }
+    state.bytes(ciram, sizeof(ciram));
+    state.bytes(palette, sizeof(palette));
+    state.bytes(oam.get(), 256);
+}
+
+void PPU::load_state(state::Reader &state)
+{
+    state.value(current_addr);
+    state.value(tmp_addr);
+    state.value(finex_scroll);
+    state.value(write_toggle);
+    state.value(ppu_ctrl);
+    state.value(ppu_mask);
+    state.value(ppu_status);
+    state.value(oam_addr);
+    state.value(io_latch);
+    state.value(data_buffer);
+    state.value(current_scanline);
+    state.value(current_dot);
+    state.value(odd_frame);
+    state.value(frames);
+    state.value(sprite0_hit_dot);
+    state.value(cpu_cycle);
+
+    for (auto &nametable : nametables) {
+        uint8_t bank;
+        state.value(bank);
+        nametable = &ciram[(bank & 0x03) * 1024];
+    }
+    state.bytes(ciram, sizeof(ciram));
+    state.bytes(palette, sizeof(palette));
+    state.bytes(oam.get(), 256);
+    event_cycle = find_next_event();
+}
+
+void PPU::set_chr_memory(const uint8_t *chr, size_t size)
+{
+    tile_cache.reset(chr, size);
+}
+
+void PPU::map_chr(int slot, const uint8_t *bank)
+{
+    catch_up();
+    chr_pages[slot] = bank;
+    chr_write_pages[slot] = nullptr;
+    chr_tiles[slot] = tile_cache.contains(bank) ? int32_t(tile_cache.tile_index(bank)) : -1;
+}
+
+void PPU::map_chr_ram(int slot, uint8_t *bank)
+{
+    map_chr(slot, bank);
+    chr_write_pages[slot] = bank;
+}
+
+void PPU::set_mirroring(Mirroring mirroring)
+{
+    // Which 1kB of nametable RAM backs $2000, $2400, $2800 and $2C00.
+    static constexpr int layouts[][4] = {
+        {0, 0, 1, 1},   // Horizontal
+        {0, 1, 0, 1},   // Vertical
+        {0, 0, 0, 0},   // SingleLower
+        {1, 1, 1, 1},   // SingleUpper
+        {0, 1, 2, 3},   // FourScreen
+    };
+    catch_up();
+    for (int i = 0; i < 4; i++) {
+        nametables[i] = &ciram[layouts[int(mirroring)][i] * 1024];
+    }
+}
+
+void PPU::oam_dma(const uint8_t *page)
+{
+    catch_up();
+    // OAMADDR wraps, it ends up where it started.
+    const size_t first = 256 - oam_addr;
+    std::memcpy(&oam[oam_addr], page, first);
+    std::memcpy(&oam[0], page + first, 256 - first);
+    io_latch = page[255];
+}
+
+uint8_t PPU::read(uint16_t addr)
+{
+    catch_up();
+    switch (addr & 0x0007) {
+    case 2: {   // PPUSTATUS
+        // Lower 5 bits are whatever was last left on the PPU's data bus.
+        const uint8_t val = (ppu_status & 0xe0) | (io_latch & 0x1f);
+        ppu_status = clear_bit(ppu_status, VBLANK);
+        update_nmi();
+        write_toggle = false;
+        io_latch = val;
+        break;
+    }
+    case 4:     // OAMDATA
+        io_latch = oam[oam_addr];
+        break;
+    case 7: {   // PPUDATA
+        const uint16_t vaddr = current_addr & 0x3fff;
+        if (vaddr < 0x3f00) {
+            io_latch = data_buffer;
+            data_buffer = vram_read(vaddr);
+        } else {
+            // Palette reads are not buffered, the buffer gets the nametable
+            // byte "underneath" the palette instead.
+            io_latch = vram_read(vaddr);
+            data_buffer = vram_read(vaddr - 0x1000);
+        }
+        increment_addr();
+        break;
+    }
+    default:    // Write-only registers.
+        break;
+    }
+    return io_latch;
+}
+
+void PPU::write(uint16_t addr, uint8_t val)
+{
+    catch_up();
+    io_latch = val;
+    switch (addr & 0x0007) {
+    case 0:     // PPUCTRL
+        ppu_ctrl = val;
+        // Enabling NMI during vblank raises it right away.
+        update_nmi();
+        // t: ...GH.. ........ <- d: ......GH
+        tmp_addr = (tmp_addr & 0xf3ff) | (uint16_t(val & 0x03) << 10);
+        break;
+    case 1:     // PPUMASK
+        ppu_mask = val;
+        // Mappers are only clocked while rendering.
+        event_cycle = find_next_event();
+        break;
+    case 3:     // OAMADDR
+        oam_addr = val;
+        break;
+    case 4:     // OAMDATA
+        oam[oam_addr++] = val;
+        break;
+    case 5:     // PPUSCROLL
+        ppu_scroll_write(val);
+        break;
+    case 6:     // PPUADDR
+        ppu_addr_write(val);
+        break;
+    case 7:     // PPUDATA
+        vram_write(current_addr & 0x3fff, val);
+        increment_addr();
+        break;
+    default:    // PPUSTATUS is read-only.
+        break;
+    }
+}
+
+void PPU::increment_addr()
+{
+    if (ppu_ctrl & INCREMENT) {
+        current_addr += 32;
+    } else {
+        current_addr += 1;
+    }
+    current_addr &= 0x7fff;
+}
+
+uint8_t PPU::vram_read(uint16_t addr) const
+{
+    addr &= 0x3fff;
+    if (addr >= 0x3f00) {
+        // $3F10/$3F14/$3F18/$3F1C mirror $3F00/$3F04/$3F08/$3F0C.
+        uint8_t index = addr & 0x1f;
+        if ((index & 0x13) == 0x10) {
+            index &= 0x0f;
+        }
+        return palette[index];
+    }
+    if (addr < 0x2000) {
+        return chr_pages[addr >> 10][addr & 0x03ff];
+    }
+    // $3000-$3EFF mirrors $2000-$2EFF.
+    return nametables[(addr >> 10) & 0x03][addr & 0x03ff];
+}
+
+void PPU::vram_write(uint16_t addr, uint8_t val)
+{
+    addr &= 0x3fff;
+    if (addr >= 0x3f00) {
+        uint8_t index = addr & 0x1f;
+        if ((index & 0x13) == 0x10) {
+            index &= 0x0f;
+        }
+        palette[index] = val;
+        return;
+    }
+    if (addr < 0x2000) {
+        const int slot = addr >> 10;
+        uint8_t *bank = chr_write_pages[slot];
+        if (bank != nullptr) {
+            bank[addr & 0x03ff] = val;
+            if (chr_tiles[slot] >= 0) {
+                tile_cache.invalidate(chr_tiles[slot] + ((addr & 0x03ff) >> 4));
+            }
+        }
+        return;
+    }
+    nametables[(addr >> 10) & 0x03][addr & 0x03ff] = val;
+}
+
+void PPU::run(uint32_t dots)
+{
+    while (dots > 0) {
+        // The pre-render line of odd frames is one dot shorter while
+        // rendering.
+        const int line_length = (current_scanline == PRERENDER_LINE && odd_frame
+                                 && rendering_enabled()) ? DOTS_PER_LINE - 1 : DOTS_PER_LINE;
+        const int end = int(std::min<uint32_t>(current_dot + dots, line_length));
+        dots -= end - current_dot;
+        run_line(end);
+
+        current_dot = end;
+        if (current_dot == line_length) {
+            current_dot = 0;
+            current_scanline++;
+            if (current_scanline == LINES_PER_FRAME) {
+                current_scanline = 0;
+                odd_frame = !odd_frame;
+            }
+        }
+    }
+}
+
+void PPU::run_until(uint64_t cycle)
+{
+    if (cycle <= cpu_cycle) {
+        return;
+    }
+#if NES_PROFILE
+    // Catching up happens on register accesses as well as at events, the
+    // time up to here went to whoever ran before.
+    if (profiler != nullptr) {
+        profiler->mark_cpu();
+    }
+#endif
+    run(uint32_t((cycle - cpu_cycle) * 3));
+#if NES_PROFILE
+    if (profiler != nullptr) {
+        profiler->mark_ppu();
+    }
+#endif
+    cpu_cycle = cycle;
+    event_cycle = find_next_event();
+}
+
+void PPU::catch_up()
+{
+    if (cpu != nullptr) {
+        run_until(cpu->bus_cycle());
+    }
+}
+
+void PPU::update_nmi()
+{
+    if (interrupts != nullptr) {
+        interrupts->set_nmi(nmi());
+    }
+}
+
+uint64_t PPU::find_next_event() const
+{
+    constexpr int FRAME_DOTS = DOTS_PER_LINE * LINES_PER_FRAME;
+    const int now = current_scanline * DOTS_PER_LINE + current_dot;
+    // Dots from now until dot of line, which may be in the next frame.
+    const auto until = [now](int line, int dot) {
+        const int at = line * DOTS_PER_LINE + dot;
+        return (at >= now) ? at - now : at + FRAME_DOTS - now;
+    };
+
+    int dots = std::min(until(VBLANK_LINE, 1), until(PRERENDER_LINE, 1));
+    if (mapper != nullptr && mapper->counts_scanlines() && rendering_enabled()) {
+        int line = (current_dot <= MAPPER_DOT) ? current_scanline : current_scanline + 1;
+        if (line >= SCREEN_HEIGHT && line < PRERENDER_LINE) {
+            line = PRERENDER_LINE;
+        } else if (line == LINES_PER_FRAME) {
+            line = 0;
+        }
+        dots = std::min(dots, until(line, MAPPER_DOT));
+    }
+    // The event's dot has to be run too, which takes one more dot, but the
+    // short pre-render line of odd frames may bring it one dot closer. Being
+    // early is harmless, the CPU then gets one more look.
+    return cpu_cycle + uint64_t(std::max(dots, 1) + 2) / 3;
+}
+
+void PPU::run_line(int end)
+{
+    // True if dot d happens in [current_dot, end).
+    const auto reaches = [this, end](int d) { return current_dot <= d && d < end; };
+
+    if (current_scanline < SCREEN_HEIGHT) {     // Visible scanlines.
+        if (reaches(0)) {
+            render_scanline();
+        }
+        if (sprite0_hit_dot >= 0 && reaches(sprite0_hit_dot)) {
+            ppu_status = set_bit(ppu_status, SPRITE_HIT);
+            sprite0_hit_dot = -1;
+        }
+    } else if (current_scanline == VBLANK_LINE) {
+        if (reaches(1)) {
+            ppu_status = set_bit(ppu_status, VBLANK);
+            update_nmi();
+            frames++;
+        }
+        return;
+    } else if (current_scanline == PRERENDER_LINE) {
+        if (reaches(1)) {
+            ppu_status = clear_bit<uint8_t>(ppu_status, VBLANK | SPRITE_HIT | SPRITE_OVERFLOW);
+            update_nmi();
+        }
+    } else {    // Post-render and the rest of vblank.
+        return;
+    }
+
+    if (!rendering_enabled()) {
+        return;
+    }
+    if (reaches(256)) {
+        increment_y();
+    }
+    if (reaches(257)) {
+        copy_x();
+    }
+    // With the usual setup (background at $0000, sprites at $1000) this is
+    // where A12 rises for the sprite fetches.
+    if (reaches(MAPPER_DOT) && mapper != nullptr) {
+        mapper->scanline();
+    }
+    if (current_scanline == PRERENDER_LINE && reaches(280)) {
+        copy_y();
+    }
 }
 
-void PPU::fetch()
+void PPU::increment_x()
 {
-    uint8_t val = *ppu_addr;
-    if (*ppu_ctrl & INCREMENT) {
-        *ppu_addr += 32;
+    if ((current_addr & 0x001f) == 31) {    // Wrap into the next nametable.
+        current_addr &= ~0x001f;
+        current_addr ^= 0x0400;
     } else {
-        *ppu_addr += 1;
+        current_addr++;
     }
 }
 
-void PPU::run()
+void PPU::increment_y()
 {
-    // Start of vertical blanking?
-    *ppu_status = set_bit(*ppu_status, VBLANK);
-    *ppu_ctrl = set_bit(*ppu_ctrl, NMI_ENABLE);
+    if ((current_addr & 0x7000) != 0x7000) {    // Fine Y.
+        current_addr += 0x1000;
+        return;
+    }
+    current_addr &= ~0x7000;
+    int coarse_y = (current_addr & 0x03e0) >> 5;
+    if (coarse_y == 29) {       // Last row, wrap into the next nametable.
+        coarse_y = 0;
+        current_addr ^= 0x0800;
+    } else if (coarse_y == 31) {    // Attribute rows wrap without switching.
+        coarse_y = 0;
+    } else {
+        coarse_y++;
+    }
+    current_addr = (current_addr & ~0x03e0) | (coarse_y << 5);
+}
 
-    // End of vertical blanking?
-    *ppu_ctrl = clear_bit(*ppu_ctrl, NMI_ENABLE);
+void PPU::copy_x()
+{
+    // v: ....F.. ...EDCBA <- t: ....F.. ...EDCBA
+    current_addr = (current_addr & ~0x041f) | (tmp_addr & 0x041f);
+}
+
+void PPU::copy_y()
+{
+    // v: GHIA.BC DEF..... <- t: GHIA.BC DEF.....
+    current_addr = (current_addr & ~0x7be0) | (tmp_addr & 0x7be0);
+}
 
-    // Read ppu_status: return old status of NMI_occurred in bit 7, then set
-    // NMI_occurred to false.
-    *ppu_status = clear_bit(*ppu_status, VBLANK);
+uint64_t PPU::tile_row(uint16_t addr)
+{
+    const int32_t first = chr_tiles[addr >> 10];
+    if (first >= 0) {
+        return tile_cache.row(first + ((addr & 0x03ff) >> 4), addr & 0x07);
+    }
+    // Pattern tables outside the cartridge's CHR memory get decoded each time.
+    uint8_t pixels[8];
+    decode_row(chr_read(addr), chr_read(addr + 8), pixels);
+    uint64_t row;
+    std::memcpy(&row, pixels, 8);
+    return row;
 }
 
-void PPU::ppu_scroll_write()
+void PPU::ppu_scroll_write(uint8_t val)
 {
     if (!write_toggle) { // First write.
-        *ppu_scroll = uint8_t((tmp_addr << 3)) | finex_scroll;
+        // t: ....... ...HGFED <- d: HGFED...
+        // x:              CBA <- d: .....CBA
+        tmp_addr = (tmp_addr & 0xffe0) | (val >> 3);
+        finex_scroll = val & 0x07;
     } else {    // Second write.
-        *ppu_scroll = uint8_t(((tmp_addr >> 2) | (tmp_addr >> 12)));
+        // t: CBA..HG FED..... <- d: HGFEDCBA
+        tmp_addr = (tmp_addr & 0x8c1f) | (uint16_t(val & 0x07) << 12)
+                 | (uint16_t(val & 0xf8) << 2);
     }
     write_toggle = !write_toggle;
 }
 
-void PPU::ppu_addr_write()
+void PPU::ppu_addr_write(uint8_t val)
 {
     if (!write_toggle) { // First write.
-        *ppu_addr = high_byte(tmp_addr);
-        // TODO: What was this supposed to do? bit_pos(14) obviously can't be set for uint8.
-        // *ppu_addr = set_bit(*ppu_addr, bit_pos(14));
-    }
-    else {    // Second write.
-        *ppu_addr = low_byte(tmp_addr);
+        // t: .FEDCBA ........ <- d: ..FEDCBA
+        // t: X...... ........ <- 0
+        tmp_addr = (tmp_addr & 0x00ff) | (uint16_t(val & 0x3f) << 8);
+    } else {    // Second write.
+        // t: ....... HGFEDCBA <- d: HGFEDCBA
+        // v: <...all bits...> <- t: <...all bits...>
+        tmp_addr = (tmp_addr & 0xff00) | val;
+        current_addr = tmp_addr;
     }
     write_toggle = !write_toggle;
 }
 
-void PPU::rendering()
+void PPU::render_scanline()
+{
+    if (!output) {
+        // Only lines with sprite 0 on them need any pixels, and only while
+        // both layers are on and it hasn't hit yet.
+        if (rendering_enabled() && evaluate_sprites()
+                && (ppu_mask & BACKGROUND_ENABLE) && (ppu_mask & SPRITE_ENABLE)
+                && sprite0_hit_dot < 0 && !(ppu_status & SPRITE_HIT)) {
+            render_background();
+            draw_sprites(true);
+            find_sprite0_hit();
+        }
+        return;
+    }
+
+    uint8_t *out = &framebuffer[current_scanline * SCREEN_WIDTH];
+    if (!rendering_enabled()) {
+        std::fill(out, out + SCREEN_WIDTH, uint8_t(palette[0] & 0x3f));
+        return;
+    }
+
+    render_background();
+    draw_sprites(evaluate_sprites());
+
+    const bool show_bg = ppu_mask & BACKGROUND_ENABLE;
+    const bool show_sprites = ppu_mask & SPRITE_ENABLE;
+    const int bg_start = (ppu_mask & BACKGROUND_LEFT) ? 0 : 8;
+    const int sprite_start = (ppu_mask & SPRITE_LEFT) ? 0 : 8;
+    const uint8_t color_mask = (ppu_mask & GREYSCALE) ? 0x30 : 0x3f;
+    const uint8_t *bg = &line_bg[finex_scroll];
+
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        const uint8_t bg_pixel = (show_bg && x >= bg_start) ? bg[x] : 0;
+        const uint8_t sprite = (show_sprites && x >= sprite_start) ? line_sprites[x] : 0;
+
+        uint8_t index = bg_pixel;
+        if (sprite & 0x03) {
+            if (bg_pixel & 0x03) {
+                if ((sprite & SPRITE_ZERO) && x != 255 && sprite0_hit_dot < 0
+                        && !(ppu_status & SPRITE_HIT)) {
+                    sprite0_hit_dot = x + 1;
+                }
+                if (!(sprite & BEHIND)) {
+                    index = sprite & 0x1f;
+                }
+            } else {
+                index = sprite & 0x1f;
+            }
+        }
+        // Transparent pixels show the backdrop color at $3F00.
+        if ((index & 0x03) == 0) {
+            index = 0;
+        }
+        out[x] = palette[index] & color_mask;
+    }
+}
+
+void PPU::render_background()
+{
+    const uint16_t pattern_base = (ppu_ctrl & BACKGROUND_TILE) ? 0x1000 : 0x0000;
+    const uint16_t fine_y = (current_addr >> 12) & 0x07;
+    // Walk a copy of v, the real one only moves at dots 256/257.
+    const uint16_t saved_addr = current_addr;
+
+    for (int tile = 0; tile < 33; tile++) {
+        const uint8_t *nametable = nametables[(current_addr >> 10) & 0x03];
+        const uint8_t tile_index = nametable[current_addr & 0x03ff];
+        const uint8_t attribute = nametable[0x03c0 | ((current_addr >> 4) & 0x38)
+                                            | ((current_addr >> 2) & 0x07)];
+        // Each attribute byte covers 4x4 tiles, 2 bits per 2x2 quadrant.
+        const int shift = ((current_addr >> 4) & 0x04) | (current_addr & 0x02);
+        const uint8_t palette_bits = ((attribute >> shift) & 0x03) << 2;
+
+        const uint64_t span = colorize(tile_row(pattern_base + tile_index * 16 + fine_y), palette_bits);
+        std::memcpy(&line_bg[tile * 8], &span, 8);
+        increment_x();
+    }
+    current_addr = saved_addr;
+}
+
+void PPU::find_sprite0_hit()
+{
+    // Sprite 0 is on top of the other sprites, so its opaque pixels are the
+    // ones flagged SPRITE_ZERO. There is no hit at x = 255.
+    const int left = std::max((ppu_mask & BACKGROUND_LEFT) ? 0 : 8, (ppu_mask & SPRITE_LEFT) ? 0 : 8);
+    const int start = std::max<int>(secondary_oam[3], left);
+    const int end = std::min<int>(secondary_oam[3] + 8, SCREEN_WIDTH - 1);
+    const uint8_t *bg = &line_bg[finex_scroll];
+    for (int x = start; x < end; x++) {
+        const uint8_t sprite = line_sprites[x];
+        if ((sprite & SPRITE_ZERO) && (sprite & 0x03) && (bg[x] & 0x03)) {
+            sprite0_hit_dot = x + 1;
+            return;
+        }
+    }
+}
+
+bool PPU::evaluate_sprites()
 {
-    // TODO: Fetch bit from 4 background shift registers.
-    // bk_16shft_reg[0] >>= 1;
-    // bk_16shft_reg[1] >>= 1;
-    // bk_8shft_reg[0] >>= 1;
-    // bk_8shft_reg[1] >>= 1;
-    // TODO: Every 8 cycles/shifts, load new data into these registers.
-    
-    // Trying to just draw a nametable.
+    // OAM Y is one less than the first line of the sprite.
+    const int height = (ppu_ctrl & SPRITE_SIZE) ? 16 : 8;
+    sprite_count = 0;
+    bool has_sprite0 = false;
+    for (int i = 0; i < 64; i++) {
+        const int row = current_scanline - (oam[i * 4] + 1);
+        if (row < 0 || row >= height) {
+            continue;
+        }
+        if (sprite_count == 8) {
+            ppu_status = set_bit(ppu_status, SPRITE_OVERFLOW);
+            break;
+        }
+        for (int b = 0; b < 4; b++) {
+            secondary_oam[sprite_count * 4 + b] = oam[i * 4 + b];
+        }
+        has_sprite0 |= (i == 0);
+        sprite_count++;
+    }
+    return has_sprite0;
+}
+
+void PPU::draw_sprites(bool sprite0)
+{
+    std::fill(std::begin(line_sprites), std::end(line_sprites), uint8_t(0));
+
+    const int height = (ppu_ctrl & SPRITE_SIZE) ? 16 : 8;
+    // Draw back to front so lower OAM indexes end up on top.
+    for (int n = sprite_count - 1; n >= 0; n--) {
+        const uint8_t *sprite = &secondary_oam[n * 4];
+        const uint8_t attributes = sprite[2];
+        const int x = sprite[3];
+        int row = current_scanline - (sprite[0] + 1);
+        if (attributes & 0x80) {    // Vertical flip.
+            row = height - 1 - row;
+        }
+
+        uint16_t addr;
+        if (height == 16) {     // Bit 0 of the tile picks the pattern table.
+            addr = ((sprite[1] & 0x01) ? 0x1000 : 0x0000) + (sprite[1] & 0xfe) * 16;
+            if (row >= 8) {
+                addr += 16;
+                row -= 8;
+            }
+        } else {
+            addr = ((ppu_ctrl & SPRITE_TILE) ? 0x1000 : 0x0000) + sprite[1] * 16;
+        }
+        addr += row;
+        const uint64_t row_pixels = tile_row(addr);
+        uint8_t pixels[8];
+        std::memcpy(pixels, &row_pixels, 8);
+        if (attributes & 0x40) {    // Horizontal flip.
+            std::reverse(std::begin(pixels), std::end(pixels));
+        }
+
+        const uint8_t flags = 0x10 | ((attributes & 0x03) << 2)
+                            | ((attributes & 0x20) ? BEHIND : 0)
+                            | ((n == 0 && sprite0) ? SPRITE_ZERO : 0);
+        for (int i = 0; i < 8 && x + i < SCREEN_WIDTH; i++) {
+            if (pixels[i]) {
+                line_sprites[x + i] = flags | pixels[i];
+            }
+        }
+    }
 }
 
 }   // Namespace ppu.
\ No newline at end of file
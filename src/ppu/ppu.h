@@ -2,25 +2,182 @@
 //
 #pragma once
 
+#include "bus.h"
+#include "cartridge.h"
 #include "nes-error.h"
+#include "ppu/tile.h"
+#include "profile.h"
+#include "state.h"
 
 #include <cstdint>
 #include <memory>
 
+namespace cpu {
+class CPU;
+class Interrupts;
+}
+namespace mapper {
+class Mapper;
+}
+
 namespace ppu {
 
-class PPU {
+static constexpr int SCREEN_WIDTH  = 256;
+static constexpr int SCREEN_HEIGHT = 240;
+
+/// Handles the CPU's $2000-$3FFF range, registers are mirrored every 8 bytes.
+///
+/// The PPU lags behind the CPU and is only run when the CPU can tell: a
+/// register access or bank switch first catches it up to the CPU's cycle, and
+/// whoever drives the CPU runs it at next_event() for vblank, NMI and mapper
+/// scanline clocks.
+class PPU : public bus::Device {
 public:
-    PPU(uint8_t ram[], uint8_t vram[]);
+    PPU();
     ~PPU() = default;
 
-    void fetch();
-    void run();
-    void ppu_scroll_write();
-    void ppu_addr_write();
-    void rendering();
+    /// Reads PPU register mapped at CPU address addr.
+    uint8_t read(uint16_t addr) override;
+    /// Writes PPU register mapped at CPU address addr.
+    void write(uint16_t addr, uint8_t val) override;
+
+    /// Sets the cartridge's CHR ROM or RAM. Banks inside it are drawn through
+    /// the decoded tile cache. Call before mapping any of its banks.
+    void set_chr_memory(const uint8_t *chr, size_t size);
+    /// Maps 1kB of CHR ROM into pattern table slot 0-7 ($0000-$1FFF).
+    void map_chr(int slot, const uint8_t *bank);
+    /// Same as map_chr() but the bank is CHR RAM and can be written.
+    void map_chr_ram(int slot, uint8_t *bank);
+    /// Points the four nametables at the internal nametable RAM.
+    void set_mirroring(Mirroring mirroring);
+    /// Mapper to clock once per rendered scanline, may be nullptr.
+    inline void set_mapper(mapper::Mapper *mapper) { this->mapper = mapper; }
+    /// CPU to catch up to before register accesses and bank switches, may be
+    /// nullptr to run the PPU only by hand.
+    inline void set_cpu(const cpu::CPU *cpu) { this->cpu = cpu; }
+    /// Interrupt lines whose NMI line follows nmi(), may be nullptr.
+    inline void set_interrupts(cpu::Interrupts *interrupts) { this->interrupts = interrupts; }
+    /// OAM DMA ($4014): the 256 bytes at page go into OAM from OAMADDR on,
+    /// like as many OAMDATA writes, in one go.
+    void oam_dma(const uint8_t *page);
+    /// Charges the time run_until() takes to profile's PPU time and the time
+    /// before it to the CPU, nullptr to stop. Does nothing unless built with
+    /// NES_PROFILE.
+    inline void set_profile(profile::Profile *profile)
+    {
+#if NES_PROFILE
+        profiler = profile;
+#else
+        (void)profile;
+#endif
+    }
+
+    /// Advances the PPU by given number of dots (PPU cycles). Leaves clock()
+    /// alone.
+    void run(uint32_t dots);
+    /// Runs the PPU up to CPU cycle cycle, 3 dots per cycle. Does nothing if
+    /// it is there already.
+    void run_until(uint64_t cycle);
+    /// CPU cycle the PPU has been run up to.
+    inline uint64_t clock() const { return cpu_cycle; }
+    /// First CPU cycle at which the PPU does something visible without a
+    /// register access: vblank starting or ending or a mapper scanline clock.
+    /// Running later than that delays NMIs and IRQs.
+    inline uint64_t next_event() const { return event_cycle; }
+
+    /// Finished frame, 256x240 palette indices ($00-$3F), one byte per pixel.
+    inline const uint8_t *frame() const { return framebuffer.get(); }
+    /// Number of frames that have entered vblank since power up.
+    inline uint64_t frame_count() const { return frames; }
+    /// True while the PPU asks for an NMI (vblank with NMI enabled).
+    inline bool nmi() const { return (ppu_status & VBLANK) && (ppu_ctrl & NMI_ENABLE); }
+
+    inline int scanline() const { return current_scanline; }
+    inline int dot() const { return current_dot; }
+
+    /// Appends registers, nametable RAM, palette, OAM, mirroring and timing to
+    /// state. The framebuffer is left out, it is redrawn by the next frame.
+    /// Pattern tables belong to the mapper.
+    void save_state(state::Writer &state) const;
+    /// Reads back what save_state() wrote.
+    void load_state(state::Reader &state);
+    /// Drops all decoded tiles, for when CHR RAM was rewritten behind the
+    /// PPU's back.
+    inline void invalidate_tiles() { tile_cache.invalidate_all(); }
+    /// Drops the decoded tile at offset in CHR memory.
+    inline void invalidate_tile(size_t offset) { tile_cache.invalidate(offset / 16); }
+
+    /// Turns drawing into the framebuffer on or off. While off, scanlines
+    /// only get what the CPU can see: sprite overflow and sprite 0 hits. For
+    /// frames that are never shown.
+    inline void set_output(bool enabled) { output = enabled; }
 
 private:
+    static constexpr int DOTS_PER_LINE  = 341;
+    static constexpr int LINES_PER_FRAME = 262;
+    static constexpr int VBLANK_LINE     = 241;
+    static constexpr int PRERENDER_LINE  = 261;
+    // Dot of rendered scanlines where mappers get clocked.
+    static constexpr int MAPPER_DOT      = 260;
+
+    /// Handles everything that happens in [current_dot, end) of the current
+    /// scanline.
+    void run_line(int end);
+    /// Runs up to the CPU's current bus access, if there is a CPU.
+    void catch_up();
+    /// Drives the NMI line with nmi().
+    void update_nmi();
+    /// Works out next_event() from the current position.
+    uint64_t find_next_event() const;
+
+    /// Draws the whole current scanline into the framebuffer, one tile span
+    /// at a time, and evaluates the sprites on it.
+    void render_scanline();
+    /// Decodes background tiles of the current scanline into line_bg.
+    void render_background();
+    /// Picks up to 8 sprites on the current scanline into secondary_oam.
+    /// Returns true if sprite 0 is among them.
+    bool evaluate_sprites();
+    /// Decodes the sprites in secondary_oam into line_sprites. sprite0 tells
+    /// if the first one is sprite 0.
+    void draw_sprites(bool sprite0);
+    /// Sets sprite0_hit_dot from line_bg and line_sprites without drawing,
+    /// the same way render_scanline() does while drawing.
+    void find_sprite0_hit();
+
+    inline bool rendering_enabled() const
+    {
+        return ppu_mask & (BACKGROUND_ENABLE | SPRITE_ENABLE);
+    }
+
+    // Scrolling steps of current_addr during rendering.
+    void increment_x();
+    void increment_y();
+    void copy_x();
+    void copy_y();
+
+    /// Reads the pattern table byte at addr ($0000-$1FFF).
+    inline uint8_t chr_read(uint16_t addr) const
+    {
+        return chr_pages[addr >> 10][addr & 0x03ff];
+    }
+
+    /// Decoded pixels of the tile row whose low plane is at addr, pixel i in
+    /// byte i of the memory representation.
+    uint64_t tile_row(uint16_t addr);
+
+    /// First/second write to PPUSCROLL.
+    void ppu_scroll_write(uint8_t val);
+    /// First/second write to PPUADDR.
+    void ppu_addr_write(uint8_t val);
+    /// Moves current_addr to the next PPUDATA location.
+    void increment_addr();
+
+    /// Reads from PPU address space ($0000-$3FFF).
+    uint8_t vram_read(uint16_t addr) const;
+    /// Writes to PPU address space ($0000-$3FFF).
+    void vram_write(uint16_t addr, uint8_t val);
+
     // The 15 bit registers current and tmp are composed this way during
     // rendering:
     /**************************************************
@@ -36,36 +193,63 @@ private:
     uint8_t finex_scroll;   // (x) Fine X scroll (3 bits).
     bool write_toggle;      // (w) First or second write toggle (1 bit).
 
-    // Memory-mapped registers.
+    // Memory-mapped registers. PPUSCROLL, PPUADDR and PPUDATA have no storage
+    // of their own, they go through the internal registers above.
     //
-    //        Name           |       Bits       |      Description
-    uint8_t *ppu_ctrl;   //  |     VPHB SINN    |  See flags in enum PPUCtrl.
-    uint8_t *ppu_mask;   //  |     BGRs bMmG    |  See flags in enum PPUMask.
-    uint8_t *ppu_status; //  |     VSO- ----    |  See flags in enum PPUStatus.
-    uint8_t *oam_addr;   //  |     aaaa aaaa    |  OAM read/write address.
-    uint8_t *oam_data;   //  |     dddd dddd    |  OAM data read/write.
-    uint8_t *ppu_scroll; //  |     xxxx xxxx    |  Fine scroll position (two writes: X scroll, 
-                         //  |                  |  Y scroll).
-    uint8_t *ppu_addr;   //  |     aaaa aaaa    |  PPU read/write address (two writes: most 
-                         //  |                  |  significant byte, least significant byte).
-    uint8_t *ppu_data;   //  |     dddd dddd    |  PPU data read/write.
-    uint8_t *oam_dma;    //  |     aaaa aaaa    |  OAM DMA high address.
-
-    // 16kB VRAM.
-    uint8_t *vram;
+    //        Name          |       Bits       |      Description
+    uint8_t ppu_ctrl;   //  |     VPHB SINN    |  See flags in enum PPUCtrl.
+    uint8_t ppu_mask;   //  |     BGRs bMmG    |  See flags in enum PPUMask.
+    uint8_t ppu_status; //  |     VSO- ----    |  See flags in enum PPUStatus.
+    uint8_t oam_addr;   //  |     aaaa aaaa    |  OAM read/write address.
+
+    // Value of the last register write, returned by write-only registers.
+    uint8_t io_latch;
+    // PPUDATA reads below the palette return the previously read byte.
+    uint8_t data_buffer;
+
+    // Pattern tables ($0000-$1FFF) in 1kB banks. Write pointers are only set
+    // for CHR RAM.
+    const uint8_t *chr_pages[8];
+    uint8_t *chr_write_pages[8];
+    // First cached tile of each slot, -1 if the slot isn't in tile_cache.
+    int32_t chr_tiles[8];
+    TileCache tile_cache;
+    // Nametables ($2000-$2FFF, mirrored up to $3EFF) in 1kB banks.
+    uint8_t *nametables[4];
+    // 2kB nametable RAM, plus 2kB more for four-screen cartridges.
+    uint8_t ciram[4 * 1024];
+    // Palette RAM ($3F00-$3F1F).
+    uint8_t palette[32];
 
     // 256 bytes OAM.
     std::unique_ptr<uint8_t[]> oam;
 
-    // TODO: Better names, please. Are these even used?
-    // Background.
-    uint16_t bk_16shft_reg[2];
-    uint8_t bk_8shft_reg[2];
-    // Sprites.
-    uint16_t spr_16shft_reg[8];
-    uint8_t spr_8shft_reg[2];
-    uint8_t latches[8];
-    uint8_t counters[8];
+    // Sprites found for the current scanline, 8 at most.
+    uint8_t secondary_oam[32];
+    int sprite_count;
+
+    // Current scanline while it is being composed. Background holds the 4 bit
+    // palette index (0 when transparent) for 33 tiles so fine X can start
+    // anywhere in the first one. Sprites hold the palette index with bit 4
+    // set, plus BEHIND and SPRITE_ZERO flags.
+    uint8_t line_bg[33 * 8];
+    uint8_t line_sprites[SCREEN_WIDTH];
+    static constexpr uint8_t BEHIND      = 0x40;
+    static constexpr uint8_t SPRITE_ZERO = 0x80;
+
+    std::unique_ptr<uint8_t[]> framebuffer;
+
+    // Dot of the current scanline where sprite 0 hits, -1 if it doesn't.
+    int sprite0_hit_dot;
+    // False while frames are run without drawing them.
+    bool output;
+
+    mapper::Mapper *mapper;
+    const cpu::CPU *cpu;
+    cpu::Interrupts *interrupts;
+#if NES_PROFILE
+    profile::Profile *profiler;
+#endif
 
     // Flags for PPUCTRL.
     static constexpr uint8_t NAMETABLE_0         = 1 << 0;   // (N) Nametable select (bit position 0).
@@ -92,7 +276,13 @@ private:
     static constexpr uint8_t SPRITE_HIT          = 1 << 6;   // (S) Sprite 0 hit.
     static constexpr uint8_t VBLANK              = 1 << 7;   // (V) vblank.
 
-    int current_scanline;
+    int current_scanline;   // 0-239 visible, 241 vblank, 261 pre-render.
+    int current_dot;        // 0-340.
+    bool odd_frame;
+    uint64_t frames;
+    // CPU cycle the current position corresponds to, and next_event().
+    uint64_t cpu_cycle;
+    uint64_t event_cycle;
 };
 
-}   // Namespace ppu.
\ No newline at end of file
+}   // Namespace ppu.
@@ -0,0 +1,184 @@
+// tile.cpp
+//
+#include "ppu/tile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#if NES_TILE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace ppu {
+
+void decode_row(uint8_t low, uint8_t high, uint8_t out[8])
+{
+    for (int i = 0; i < 8; i++) {
+        out[i] = ((low >> (7 - i)) & 0x01) | (((high >> (7 - i)) & 0x01) << 1);
+    }
+}
+
+void decode_rows_scalar(const uint8_t *low, const uint8_t *high,
+                        const uint8_t *attr, int count, uint8_t *out)
+{
+    for (int tile = 0; tile < count; tile++) {
+        uint8_t *span = &out[tile * 8];
+        decode_row(low[tile], high[tile], span);
+        for (int i = 0; i < 8; i++) {
+            span[i] = span[i] ? (attr[tile] | span[i]) : 0;
+        }
+    }
+}
+
+namespace {
+
+/// 8 decoded pixels per plane pair, stored in memory order.
+std::unique_ptr<uint64_t[]> build_lut()
+{
+    auto lut = std::make_unique<uint64_t[]>(64 * 1024);
+    for (int high = 0; high < 256; high++) {
+        for (int low = 0; low < 256; low++) {
+            uint8_t pixels[8];
+            decode_row(uint8_t(low), uint8_t(high), pixels);
+            std::memcpy(&lut[(high << 8) | low], pixels, 8);
+        }
+    }
+    return lut;
+}
+
+}   // Anonymous namespace.
+
+void decode_rows_lut(const uint8_t *low, const uint8_t *high,
+                     const uint8_t *attr, int count, uint8_t *out)
+{
+    static const std::unique_ptr<uint64_t[]> lut = build_lut();
+
+    for (int tile = 0; tile < count; tile++) {
+        const uint64_t span = colorize(lut[(high[tile] << 8) | low[tile]], attr[tile]);
+        std::memcpy(&out[tile * 8], &span, 8);
+    }
+}
+
+#if NES_TILE_X86
+
+// Pixel order within a tile row: bit 7 first.
+#define NES_TILE_BITS char(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+
+void decode_rows_sse2(const uint8_t *low, const uint8_t *high,
+                      const uint8_t *attr, int count, uint8_t *out)
+{
+    const __m128i bits = _mm_setr_epi8(NES_TILE_BITS, NES_TILE_BITS);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+
+    // Spreads bytes a and b over lanes 0-7 and 8-15.
+    const auto broadcast = [](uint8_t a, uint8_t b) {
+        __m128i v = _mm_cvtsi32_si128(a | (b << 8));
+        v = _mm_unpacklo_epi8(v, v);
+        v = _mm_unpacklo_epi16(v, v);
+        return _mm_unpacklo_epi32(v, v);
+    };
+
+    int tile = 0;
+    for (; tile + 2 <= count; tile += 2) {
+        const __m128i lo = _mm_cmpeq_epi8(_mm_and_si128(broadcast(low[tile], low[tile + 1]), bits), bits);
+        const __m128i hi = _mm_cmpeq_epi8(_mm_and_si128(broadcast(high[tile], high[tile + 1]), bits), bits);
+        const __m128i pixels = _mm_or_si128(_mm_and_si128(lo, one), _mm_and_si128(hi, two));
+        const __m128i attrs = _mm_and_si128(broadcast(attr[tile], attr[tile + 1]), _mm_or_si128(lo, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&out[tile * 8]), _mm_or_si128(pixels, attrs));
+    }
+    decode_rows_scalar(low + tile, high + tile, attr + tile, count - tile, out + tile * 8);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define NES_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NES_TARGET_AVX2
+#endif
+
+NES_TARGET_AVX2
+void decode_rows_avx2(const uint8_t *low, const uint8_t *high,
+                      const uint8_t *attr, int count, uint8_t *out)
+{
+    const __m256i bits = _mm256_setr_epi8(NES_TILE_BITS, NES_TILE_BITS, NES_TILE_BITS, NES_TILE_BITS);
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi8(2);
+    // Byte 0/1 of the 32 bit source to the low lane, byte 2/3 to the high one.
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+
+    const auto broadcast = [&spread](const uint8_t *src) NES_TARGET_AVX2 {
+        int32_t v;
+        std::memcpy(&v, src, 4);
+        return _mm256_shuffle_epi8(_mm256_set1_epi32(v), spread);
+    };
+
+    int tile = 0;
+    for (; tile + 4 <= count; tile += 4) {
+        const __m256i lo = _mm256_cmpeq_epi8(_mm256_and_si256(broadcast(&low[tile]), bits), bits);
+        const __m256i hi = _mm256_cmpeq_epi8(_mm256_and_si256(broadcast(&high[tile]), bits), bits);
+        const __m256i pixels = _mm256_or_si256(_mm256_and_si256(lo, one), _mm256_and_si256(hi, two));
+        const __m256i attrs = _mm256_and_si256(broadcast(&attr[tile]), _mm256_or_si256(lo, hi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(&out[tile * 8]), _mm256_or_si256(pixels, attrs));
+    }
+    decode_rows_sse2(low + tile, high + tile, attr + tile, count - tile, out + tile * 8);
+}
+
+#undef NES_TILE_BITS
+
+bool avx2_supported()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+#endif  // NES_TILE_X86
+
+DecodeRows best_decoder()
+{
+#if defined(NES_TILE_LUT)
+    return decode_rows_lut;
+#elif NES_TILE_X86
+    return avx2_supported() ? decode_rows_avx2 : decode_rows_sse2;
+#else
+    return decode_rows_scalar;
+#endif
+}
+
+void TileCache::reset(const uint8_t *chr, size_t size)
+{
+    this->chr = chr;
+    rows.assign(size / 16 * 8, 0);
+    valid.assign(size / 16, false);
+}
+
+void TileCache::invalidate_all()
+{
+    std::fill(valid.begin(), valid.end(), uint8_t(false));
+}
+
+void TileCache::decode(size_t tile)
+{
+    // The 8 rows of the low plane are followed by the 8 rows of the high one.
+    static constexpr uint8_t no_attr[8] = {};
+    const uint8_t *planes = &chr[tile * 16];
+    decode_rows(planes, planes + 8, no_attr, 8, reinterpret_cast<uint8_t *>(&rows[tile * 8]));
+    valid[tile] = true;
+}
+
+}   // Namespace ppu.
@@ -0,0 +1,109 @@
+// tile.h : Pattern table decoding. A tile row is two bit planes, bit 7 being
+// the leftmost pixel. Decoding interleaves them into eight 2 bit pixels.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ppu {
+
+/// Decodes count tile rows into count * 8 palette indexes. Row i uses planes
+/// low[i]/high[i] and palette bits attr[i] (palette number << 2). Transparent
+/// pixels come out as 0, others as attr[i] | pixel.
+using DecodeRows = void (*)(const uint8_t *low, const uint8_t *high,
+                            const uint8_t *attr, int count, uint8_t *out);
+
+/// Decodes a single tile row into 8 pixels (0-3).
+void decode_row(uint8_t low, uint8_t high, uint8_t out[8]);
+
+/// Bit-by-bit reference implementation.
+void decode_rows_scalar(const uint8_t *low, const uint8_t *high,
+                        const uint8_t *attr, int count, uint8_t *out);
+
+/// Looks every row up in a 64k-entry table indexed by (high << 8) | low. The
+/// table is 512kB and built on first use.
+void decode_rows_lut(const uint8_t *low, const uint8_t *high,
+                     const uint8_t *attr, int count, uint8_t *out);
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define NES_TILE_X86 1
+
+/// Two tiles per 128 bit vector.
+void decode_rows_sse2(const uint8_t *low, const uint8_t *high,
+                      const uint8_t *attr, int count, uint8_t *out);
+
+/// Four tiles per 256 bit vector. Only call if avx2_supported().
+void decode_rows_avx2(const uint8_t *low, const uint8_t *high,
+                      const uint8_t *attr, int count, uint8_t *out);
+
+/// True if the running CPU has AVX2.
+bool avx2_supported();
+#endif
+
+/// Returns the fastest decoder for this build and CPU. Building with
+/// NES_TILE_LUT prefers the lookup table over SIMD.
+DecodeRows best_decoder();
+
+/// Gives the opaque pixels of a decoded row (pixel i in byte i of its memory
+/// representation) the palette bits attr.
+inline uint64_t colorize(uint64_t pixels, uint8_t attr)
+{
+    // Each opaque pixel has bit 0 or 1 set in its byte, spread that over the
+    // whole byte so the mask covers the attribute bits too.
+    const uint64_t opaque = ((pixels | (pixels >> 1)) & 0x0101010101010101ull) * 0xff;
+    return pixels | ((attr * 0x0101010101010101ull) & opaque);
+}
+
+/// Decodes with best_decoder().
+inline void decode_rows(const uint8_t *low, const uint8_t *high,
+                        const uint8_t *attr, int count, uint8_t *out)
+{
+    static const DecodeRows decoder = best_decoder();
+    decoder(low, high, attr, count, out);
+}
+
+/// Pattern tables of one block of CHR memory (the cartridge's CHR ROM or RAM)
+/// decoded to one byte per pixel. Tiles are decoded the first time they are
+/// drawn and stay decoded until invalidate()d, which CHR RAM writes have to
+/// do. Tiles are indexed by their offset in the block / 16, so bank switches
+/// don't touch the cache.
+class TileCache {
+public:
+    /// Caches the size bytes at chr. Everything starts out undecoded.
+    void reset(const uint8_t *chr, size_t size);
+
+    /// True if bank (1kB) lies in the cached block.
+    inline bool contains(const uint8_t *bank) const
+    {
+        return chr != nullptr && bank >= chr && bank + 1024 <= chr + valid.size() * 16;
+    }
+    /// Index of the first tile of bank, which has to be contained.
+    inline size_t tile_index(const uint8_t *bank) const { return size_t(bank - chr) / 16; }
+
+    /// Pixels of row 0-7 of tile, pixel i in byte i of the memory
+    /// representation.
+    inline uint64_t row(size_t tile, int row)
+    {
+        if (!valid[tile]) {
+            decode(tile);
+        }
+        return rows[tile * 8 + row];
+    }
+
+    /// Forces tile to be decoded again on its next use.
+    inline void invalidate(size_t tile) { valid[tile] = false; }
+    /// Forces every tile to be decoded again, for when the whole block was
+    /// rewritten.
+    void invalidate_all();
+
+private:
+    void decode(size_t tile);
+
+    const uint8_t *chr = nullptr;
+    std::vector<uint64_t> rows;
+    std::vector<uint8_t> valid;
+};
+
+}   // Namespace ppu.
@@ -0,0 +1,193 @@
+// profile.cpp
+//
+#include "profile.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+
+namespace profile {
+
+namespace {
+
+constexpr cpu::AddrMode MODES[] = {
+    cpu::AddrMode::Implied, cpu::AddrMode::Accumulator, cpu::AddrMode::Immediate,
+    cpu::AddrMode::ZeroPage, cpu::AddrMode::ZeroPageX, cpu::AddrMode::ZeroPageY,
+    cpu::AddrMode::Relative, cpu::AddrMode::Absolute, cpu::AddrMode::AbsoluteX,
+    cpu::AddrMode::AbsoluteY, cpu::AddrMode::Indirect, cpu::AddrMode::IndexedIndirect,
+    cpu::AddrMode::IndirectIndexed,
+};
+
+struct FileCloser {
+    void operator()(std::FILE *file) const { std::fclose(file); }
+};
+using File = std::unique_ptr<std::FILE, FileCloser>;
+
+/// Writes out to path. Returns CouldNotOpenFile on failure.
+NesError write_file(const std::string &path, const fmt::memory_buffer &out)
+{
+    File file(std::fopen(path.c_str(), "wb"));
+    if (file == nullptr || std::fwrite(out.data(), 1, out.size(), file.get()) != out.size()) {
+        fmt::print(stderr, "Failed to write {}\n", path);
+        return NesError::CouldNotOpenFile;
+    }
+    return NesError::Success;
+}
+
+}   // Anonymous namespace.
+
+Profile::Profile()
+    : pc_hits(64 * 1024)
+{
+    clear();
+}
+
+void Profile::clear(uint64_t frame)
+{
+    opcodes.fill({0, 0});
+    std::fill(pc_hits.begin(), pc_hits.end(), 0);
+    frame_list.clear();
+    current = {};
+    current.number = frame;
+    last_mark = std::chrono::steady_clock::now();
+}
+
+Counter Profile::mode(cpu::AddrMode mode) const
+{
+    Counter sum = {0, 0};
+    for (int code = 0; code < 256; code++) {
+        if (cpu::OPCODES[code].mode == mode && cpu::OPCODES[code].instr != cpu::Instr::Invalid) {
+            sum.count += opcodes[code].count;
+            sum.cycles += opcodes[code].cycles;
+        }
+    }
+    return sum;
+}
+
+void Profile::end_frame(uint64_t number)
+{
+    frame_list.push_back(current);
+    current = {};
+    current.number = number;
+}
+
+std::vector<uint16_t> Profile::hot_pcs() const
+{
+    std::vector<uint16_t> pcs;
+    for (size_t pc = 0; pc < pc_hits.size(); pc++) {
+        if (pc_hits[pc] != 0) {
+            pcs.push_back(uint16_t(pc));
+        }
+    }
+    std::stable_sort(pcs.begin(), pcs.end(), [this](uint16_t a, uint16_t b) {
+        return pc_hits[a] > pc_hits[b];
+    });
+    return pcs;
+}
+
+NesError Profile::write_csv(const std::string &prefix) const
+{
+    fmt::memory_buffer out;
+    auto it = std::back_inserter(out);
+    fmt::format_to(it, "opcode,instr,mode,count,cycles\n");
+    for (int code = 0; code < 256; code++) {
+        const cpu::OpcodeInfo &info = cpu::OPCODES[code];
+        if (info.instr != cpu::Instr::Invalid) {
+            fmt::format_to(it, "{:02X},{},{},{},{}\n", code,
+                           cpu::mnemonic(info.instr), cpu::mode_name(info.mode),
+                           opcodes[code].count, opcodes[code].cycles);
+        }
+    }
+    NesError err = write_file(prefix + "opcodes.csv", out);
+    if (err != NesError::Success) {
+        return err;
+    }
+
+    out.clear();
+    fmt::format_to(it, "mode,count,cycles\n");
+    for (const cpu::AddrMode m : MODES) {
+        const Counter sum = mode(m);
+        fmt::format_to(it, "{},{},{}\n", cpu::mode_name(m), sum.count, sum.cycles);
+    }
+    err = write_file(prefix + "modes.csv", out);
+    if (err != NesError::Success) {
+        return err;
+    }
+
+    out.clear();
+    fmt::format_to(it, "pc,count\n");
+    for (const uint16_t pc : hot_pcs()) {
+        fmt::format_to(it, "{:04X},{}\n", pc, pc_hits[pc]);
+    }
+    err = write_file(prefix + "pcs.csv", out);
+    if (err != NesError::Success) {
+        return err;
+    }
+
+    out.clear();
+    fmt::format_to(it, "frame,instructions,cpu_cycles,cpu_ns,ppu_ns\n");
+    for (const Frame &f : frame_list) {
+        fmt::format_to(it, "{},{},{},{},{}\n",
+                       f.number, f.instructions, f.cpu_cycles, f.cpu_ns, f.ppu_ns);
+    }
+    return write_file(prefix + "frames.csv", out);
+}
+
+NesError Profile::write_json(const std::string &path) const
+{
+    fmt::memory_buffer out;
+    auto it = std::back_inserter(out);
+    const auto separator = [&it](bool first) {
+        fmt::format_to(it, "{}\n    ", first ? "" : ",");
+    };
+
+    fmt::format_to(it, "{{\n  \"opcodes\": [");
+    bool first = true;
+    for (int code = 0; code < 256; code++) {
+        const cpu::OpcodeInfo &info = cpu::OPCODES[code];
+        if (info.instr == cpu::Instr::Invalid) {
+            continue;
+        }
+        separator(first);
+        first = false;
+        fmt::format_to(it,
+                       "{{\"opcode\": {}, \"instr\": \"{}\", \"mode\": \"{}\", \"count\": {}, \"cycles\": {}}}",
+                       code, cpu::mnemonic(info.instr), cpu::mode_name(info.mode),
+                       opcodes[code].count, opcodes[code].cycles);
+    }
+
+    fmt::format_to(it, "\n  ],\n  \"modes\": [");
+    first = true;
+    for (const cpu::AddrMode m : MODES) {
+        const Counter sum = mode(m);
+        separator(first);
+        first = false;
+        fmt::format_to(it, "{{\"mode\": \"{}\", \"count\": {}, \"cycles\": {}}}",
+                       cpu::mode_name(m), sum.count, sum.cycles);
+    }
+
+    fmt::format_to(it, "\n  ],\n  \"pcs\": [");
+    first = true;
+    for (const uint16_t pc : hot_pcs()) {
+        separator(first);
+        first = false;
+        fmt::format_to(it, "{{\"pc\": {}, \"count\": {}}}", pc, pc_hits[pc]);
+    }
+
+    fmt::format_to(it, "\n  ],\n  \"frames\": [");
+    first = true;
+    for (const Frame &f : frame_list) {
+        separator(first);
+        first = false;
+        fmt::format_to(it,
+                       "{{\"frame\": {}, \"instructions\": {}, \"cpu_cycles\": {}, \"cpu_ns\": {}, \"ppu_ns\": {}}}",
+                       f.number, f.instructions, f.cpu_cycles, f.cpu_ns, f.ppu_ns);
+    }
+    fmt::format_to(it, "\n  ]\n}}\n");
+    return write_file(path, out);
+}
+
+}   // Namespace profile.
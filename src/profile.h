@@ -0,0 +1,103 @@
+// profile.h : Where emulation time goes. Built with NES_PROFILE the CPU counts
+// every instruction it executes by opcode and address, and the PPU times how
+// long catching up takes, at events and register accesses alike, splitting
+// each frame into CPU and PPU time. Without it nothing is counted and the
+// hooks compile away.
+//
+#pragma once
+
+#include "cpu/opcodes.h"
+#include "nes-error.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if !defined(NES_PROFILE)
+#define NES_PROFILE 0
+#endif
+
+namespace profile {
+
+/// Work done during one frame. Times include the profiler's own clock reads.
+struct Frame {
+    uint64_t number;
+    uint64_t instructions;
+    uint64_t cpu_cycles;
+    uint64_t cpu_ns;
+    uint64_t ppu_ns;
+};
+
+/// Instructions executed and the cycles they took.
+struct Counter {
+    uint64_t count;
+    uint64_t cycles;
+};
+
+class Profile {
+public:
+    Profile();
+
+    /// Forgets everything counted so far, counting goes on with frame.
+    void clear(uint64_t frame = 0);
+
+    /// Counts the instruction at pc, opcode, which took cycles.
+    inline void instruction(uint8_t opcode, uint16_t pc, uint32_t cycles)
+    {
+        opcodes[opcode].count++;
+        opcodes[opcode].cycles += cycles;
+        pc_hits[pc]++;
+        current.instructions++;
+        current.cpu_cycles += cycles;
+    }
+
+    /// Charges the time since the last mark to the CPU or the PPU.
+    inline void mark_cpu() { current.cpu_ns += elapsed(); }
+    inline void mark_ppu() { current.ppu_ns += elapsed(); }
+    /// Closes the current frame once the PPU reports a new frame number.
+    inline void set_frame(uint64_t number)
+    {
+        if (number != current.number) {
+            end_frame(number);
+        }
+    }
+
+    inline const Counter &opcode(uint8_t code) const { return opcodes[code]; }
+    /// Sum over every opcode using mode.
+    Counter mode(cpu::AddrMode mode) const;
+    /// Times the instruction at pc executed.
+    inline uint64_t hits(uint16_t pc) const { return pc_hits[pc]; }
+    /// Finished frames, oldest first.
+    inline const std::vector<Frame> &frames() const { return frame_list; }
+
+    /// Writes <prefix>opcodes.csv, <prefix>modes.csv, <prefix>pcs.csv (only
+    /// addresses that executed, hottest first) and <prefix>frames.csv.
+    /// Returns CouldNotOpenFile if one can't be written.
+    NesError write_csv(const std::string &prefix) const;
+    /// Writes all of it as one JSON object with the same tables.
+    NesError write_json(const std::string &path) const;
+
+private:
+    void end_frame(uint64_t number);
+
+    inline uint64_t elapsed()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_mark);
+        last_mark = now;
+        return uint64_t(ns.count());
+    }
+
+    /// Executed addresses, hottest first.
+    std::vector<uint16_t> hot_pcs() const;
+
+    std::array<Counter, 256> opcodes;
+    std::vector<uint64_t> pc_hits;
+    std::vector<Frame> frame_list;
+    Frame current;
+    std::chrono::steady_clock::time_point last_mark;
+};
+
+}   // Namespace profile.
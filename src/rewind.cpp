@@ -0,0 +1,218 @@
+// rewind.cpp
+//
+#include "rewind.h"
+
+#include <cstring>
+
+namespace {
+
+void put_varint(uint8_t *&out, size_t val)
+{
+    while (val >= 0x80) {
+        *out++ = uint8_t(val | 0x80);
+        val >>= 7;
+    }
+    *out++ = uint8_t(val);
+}
+
+size_t get_varint(const uint8_t *&in)
+{
+    size_t val = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = *in++;
+        val |= size_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return val;
+        }
+    }
+}
+
+}   // Anonymous namespace.
+
+Rewind::Rewind(size_t budget, unsigned interval, unsigned keyframe_interval)
+    : ring(std::make_unique<uint8_t[]>(budget)),
+      budget(budget),
+      interval(interval ? interval : 1),
+      keyframe_interval(keyframe_interval ? keyframe_interval : 1),
+      since_keyframe(this->keyframe_interval),
+      keyframe_frame(0)
+{
+}
+
+// Encoded as pairs of runs: varint count of unchanged bytes, varint count of
+// changed bytes followed by those bytes XORed with ref.
+size_t Rewind::encode(const uint8_t *state, const uint8_t *ref, size_t size, uint8_t *out)
+{
+    const auto changed = [state, ref](size_t i) {
+        return uint8_t(ref ? (state[i] ^ ref[i]) : state[i]);
+    };
+
+    uint8_t *start = out;
+    size_t i = 0;
+    while (i < size) {
+        const size_t same_start = i;
+        while (i < size && changed(i) == 0) {
+            i++;
+        }
+        const size_t literal_start = i;
+        while (i < size && changed(i) != 0) {
+            i++;
+        }
+        put_varint(out, literal_start - same_start);
+        put_varint(out, i - literal_start);
+        for (size_t j = literal_start; j < i; j++) {
+            *out++ = changed(j);
+        }
+    }
+    return size_t(out - start);
+}
+
+void Rewind::decode(const uint8_t *in, const uint8_t *ref, size_t size, uint8_t *out)
+{
+    size_t i = 0;
+    while (i < size) {
+        const size_t same = get_varint(in);
+        if (ref) {
+            std::memcpy(&out[i], &ref[i], same);
+        } else {
+            std::memset(&out[i], 0, same);
+        }
+        i += same;
+
+        const size_t literal = get_varint(in);
+        for (size_t j = 0; j < literal; j++, i++) {
+            out[i] = ref ? uint8_t(ref[i] ^ *in++) : *in++;
+        }
+    }
+}
+
+size_t Rewind::used() const
+{
+    size_t total = 0;
+    for (const auto &entry : entries) {
+        total += entry.size;
+    }
+    return total;
+}
+
+void Rewind::evict()
+{
+    entries.pop_front();
+    // Deltas without their keyframe are useless.
+    while (!entries.empty() && !entries.front().keyframe) {
+        entries.pop_front();
+    }
+}
+
+bool Rewind::allocate(size_t size, size_t &offset)
+{
+    if (size > budget) {
+        return false;
+    }
+    size_t head = 0;
+    if (!entries.empty()) {
+        head = entries.back().offset + entries.back().size;
+    }
+    if (head + size > budget) {
+        // Skip the end of the ring. Whatever is stored there is older than
+        // anything at the start.
+        while (!entries.empty() && entries.front().offset >= head) {
+            evict();
+        }
+        head = 0;
+    }
+    // The oldest entry is the next one after head.
+    while (!entries.empty()) {
+        const Entry &oldest = entries.front();
+        if (oldest.offset >= head + size || oldest.offset + oldest.size <= head) {
+            break;
+        }
+        evict();
+    }
+    offset = head;
+    return true;
+}
+
+void Rewind::record(const Console &console)
+{
+    const uint64_t frame = console.ppu().frame_count();
+    if (frame % interval != 0) {
+        return;
+    }
+    if (state.empty()) {
+        state.resize(console.state_size());
+        keyframe.resize(state.size());
+        encoded.resize(max_encoded(state.size()));
+    }
+    if (console.snapshot(state.data(), state.size()) != NesError::Success) {
+        return;
+    }
+
+    for (;;) {
+        const bool is_keyframe = since_keyframe >= keyframe_interval;
+        const size_t size = encode(state.data(), is_keyframe ? nullptr : keyframe.data(),
+                                   state.size(), encoded.data());
+        size_t offset;
+        if (!allocate(size, offset)) {
+            return;
+        }
+        // Making room may have dropped the keyframe this delta is against.
+        if (!is_keyframe && (entries.empty() || entries.front().frame > keyframe_frame)) {
+            since_keyframe = keyframe_interval;
+            continue;
+        }
+
+        std::memcpy(&ring[offset], encoded.data(), size);
+        entries.push_back({frame, offset, size, is_keyframe});
+        if (is_keyframe) {
+            std::memcpy(keyframe.data(), state.data(), state.size());
+            keyframe_frame = frame;
+            since_keyframe = 0;
+        }
+        since_keyframe++;
+        return;
+    }
+}
+
+void Rewind::load(size_t index)
+{
+    size_t key = index;
+    while (!entries[key].keyframe) {
+        key--;
+    }
+    decode(&ring[entries[key].offset], nullptr, state.size(), keyframe.data());
+    if (key == index) {
+        std::memcpy(state.data(), keyframe.data(), state.size());
+    } else {
+        decode(&ring[entries[index].offset], keyframe.data(), state.size(), state.data());
+    }
+}
+
+NesError Rewind::seek(Console &console, uint64_t frame)
+{
+    if (entries.empty() || frame < oldest_frame() || frame > newest_frame()) {
+        return NesError::InvalidState;
+    }
+    size_t index = entries.size() - 1;
+    while (entries[index].frame > frame) {
+        index--;
+    }
+
+    load(index);
+    // The keyframe scratch now holds the keyframe of index, not the newest
+    // one, whether the restore works or not. Start a fresh one.
+    since_keyframe = keyframe_interval;
+    const NesError err = console.restore(state.data(), state.size());
+    if (err != NesError::Success) {
+        return err;
+    }
+    entries.resize(index + 1);
+
+    while (console.ppu().frame_count() < frame) {
+        const NesError run_err = console.run_frame();
+        if (run_err != NesError::Success) {
+            return run_err;
+        }
+    }
+    return NesError::Success;
+}
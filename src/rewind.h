@@ -0,0 +1,79 @@
+// rewind.h : Rewind history. Console states are recorded every few frames
+// into a fixed-size ring, each one stored as the run-length encoded XOR
+// against the last keyframe, so mostly unchanged states take a few hundred
+// bytes.
+//
+#pragma once
+
+#include "console.h"
+#include "nes-error.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+class Rewind {
+public:
+    /// Keeps at most budget bytes of encoded states. Records a state every
+    /// interval frames and makes every keyframe_interval'th state a keyframe.
+    explicit Rewind(size_t budget, unsigned interval = 1, unsigned keyframe_interval = 60);
+    Rewind(const Rewind&) = delete;
+    Rewind &operator=(const Rewind&) = delete;
+
+    /// Call after each Console::run_frame(). Records the state if the frame
+    /// is due, dropping the oldest states to make room.
+    void record(const Console &console);
+
+    /// Restores the newest state at or before frame, then runs the console
+    /// up to frame. States after frame are dropped, the console now continues
+    /// from there. Returns InvalidState if frame is outside the window.
+    NesError seek(Console &console, uint64_t frame);
+
+    /// Oldest/newest recorded frame. Only valid if !empty().
+    inline uint64_t oldest_frame() const { return entries.front().frame; }
+    inline uint64_t newest_frame() const { return entries.back().frame; }
+    inline bool empty() const { return entries.empty(); }
+    inline size_t count() const { return entries.size(); }
+    /// Bytes of the ring holding states.
+    size_t used() const;
+
+private:
+    struct Entry {
+        uint64_t frame;
+        size_t offset;      // In ring.
+        size_t size;
+        bool keyframe;
+    };
+
+    /// Encodes size bytes of state, XORed with ref unless it is nullptr.
+    /// Returns the encoded size, out needs room for max_encoded(size).
+    static size_t encode(const uint8_t *state, const uint8_t *ref, size_t size, uint8_t *out);
+    /// Reverses encode().
+    static void decode(const uint8_t *in, const uint8_t *ref, size_t size, uint8_t *out);
+    static size_t max_encoded(size_t size) { return size * 2 + 16; }
+
+    /// Finds room for size bytes, evicting old entries. Returns false if
+    /// size is larger than the whole ring.
+    bool allocate(size_t size, size_t &offset);
+    /// Drops the oldest entry and the deltas that depended on it.
+    void evict();
+    /// Decodes entry (and its keyframe) into state.
+    void load(size_t index);
+
+    std::unique_ptr<uint8_t[]> ring;
+    size_t budget;
+    unsigned interval;
+    unsigned keyframe_interval;
+    std::deque<Entry> entries;
+
+    // Scratch space, sized on the first record().
+    std::vector<uint8_t> state;
+    std::vector<uint8_t> keyframe;      // Decoded state of the newest keyframe.
+    std::vector<uint8_t> encoded;
+    // States recorded since the last keyframe. Starts full so the first state
+    // is a keyframe.
+    unsigned since_keyframe;
+    uint64_t keyframe_frame;
+};
@@ -0,0 +1,37 @@
+// run-ahead.cpp
+//
+#include "run-ahead.h"
+
+NesError RunAhead::run_frame(Console &console)
+{
+    if (ahead == 0) {
+        return console.run_frame();
+    }
+    if (state.size() != console.state_size()) {
+        state.resize(console.state_size());
+    }
+
+    // The real frame is heard but not seen.
+    console.set_video_output(false);
+    NesError err = console.run_frame();
+    if (err == NesError::Success) {
+        err = console.snapshot(state.data(), state.size());
+    }
+    if (err != NesError::Success) {
+        console.set_video_output(true);
+        return err;
+    }
+
+    // Speculative frames are never heard, and only the last one is seen.
+    console.set_audio_output(false);
+    for (unsigned i = 0; i < ahead; i++) {
+        console.set_video_output(i + 1 == ahead);
+        if (console.run_frame() != NesError::Success) {
+            break;
+        }
+    }
+    console.set_video_output(true);
+    err = console.restore(state.data(), state.size());
+    console.set_audio_output(true);
+    return err;
+}
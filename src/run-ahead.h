@@ -0,0 +1,37 @@
+// run-ahead.h : Run-ahead input latency reduction. Each frame is run for
+// real without drawing, then the console runs a few more frames with the same
+// input and no sound, the last one drawn, and rolls back. What gets shown is
+// that future frame, so a game that takes N frames to react to a button press
+// appears to react N frames sooner.
+//
+#pragma once
+
+#include "console.h"
+#include "nes-error.h"
+
+#include <cstdint>
+#include <vector>
+
+class RunAhead {
+public:
+    /// Shows the frame frames ahead of the real one. 0 turns run-ahead off.
+    explicit RunAhead(unsigned frames) : ahead(frames) {}
+    RunAhead(const RunAhead&) = delete;
+    RunAhead &operator=(const RunAhead&) = delete;
+
+    /// Replaces Console::run_frame(). Runs one frame for real, then the
+    /// speculative ones with whatever input the console has now, and restores
+    /// the real frame's state. Console::ppu().frame() is left holding the
+    /// last speculative frame: restore() doesn't touch the framebuffer and
+    /// the real frame isn't drawn. Sound comes from the real frame only. A
+    /// crash in a speculative frame isn't reported, the real timeline may
+    /// never get there.
+    NesError run_frame(Console &console);
+
+    inline unsigned frames() const { return ahead; }
+
+private:
+    unsigned ahead;
+    // Snapshot of the real frame, sized on the first run_frame().
+    std::vector<uint8_t> state;
+};
@@ -0,0 +1,94 @@
+// spsc-ring.h : Lock-free ring buffer for exactly one producer thread and one
+// consumer thread. Storage is allocated once, pushing and popping never block
+// or allocate.
+//
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+template <typename T>
+class SpscRing {
+public:
+    /// Holds up to capacity items, rounded up to a power of two.
+    explicit SpscRing(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        items = std::make_unique<T[]>(size);
+        mask = size - 1;
+    }
+    SpscRing(const SpscRing&) = delete;
+    SpscRing &operator=(const SpscRing&) = delete;
+
+    /// Producer only. Returns false if the ring is full.
+    inline bool push(const T &item)
+    {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        if (pos - tail_cache > mask) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (pos - tail_cache > mask) {
+                return false;
+            }
+        }
+        items[pos & mask] = item;
+        head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Producer only. Pushes as many of count items as fit, returns how many.
+    inline size_t push(const T *src, size_t count)
+    {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        size_t free = capacity() - (pos - tail_cache);
+        if (free < count) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            free = capacity() - (pos - tail_cache);
+        }
+        const size_t n = (count < free) ? count : free;
+        for (size_t i = 0; i < n; i++) {
+            items[(pos + i) & mask] = src[i];
+        }
+        head.store(pos + n, std::memory_order_release);
+        return n;
+    }
+
+    /// Consumer only. Moves up to max items into out, returns how many.
+    inline size_t pop(T *out, size_t max)
+    {
+        const size_t pos = tail.load(std::memory_order_relaxed);
+        size_t available = head_cache - pos;
+        if (available < max) {
+            head_cache = head.load(std::memory_order_acquire);
+            available = head_cache - pos;
+        }
+        const size_t n = (max < available) ? max : available;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = items[(pos + i) & mask];
+        }
+        tail.store(pos + n, std::memory_order_release);
+        return n;
+    }
+
+    /// Items waiting, only exact when called from either end.
+    inline size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    inline size_t capacity() const { return mask + 1; }
+
+private:
+    std::unique_ptr<T[]> items;
+    size_t mask;
+
+    // Each side owns a cache line: its index plus its last view of the other
+    // side's index, so it only touches the other line when it looks full or
+    // empty.
+    alignas(64) std::atomic<size_t> head{0};
+    size_t tail_cache = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t head_cache = 0;
+};
@@ -0,0 +1,95 @@
+// state.h : Save-state serialization. Components append their fields to a
+// caller-provided buffer in a fixed order and read them back the same way.
+// Nothing is allocated and every field is a plain copy, so the format is only
+// meant to be read by the same build on the same kind of machine.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace state {
+
+/// "NESS" in little endian.
+static constexpr uint32_t MAGIC   = 0x5353454e;
+/// Bump whenever any component changes what it saves.
+static constexpr uint32_t VERSION = 5;
+
+/// Appends bytes to a fixed-size buffer. Writing past the end stops copying
+/// but keeps counting, so a writer over an empty buffer measures the size of
+/// a state.
+class Writer {
+public:
+    Writer(uint8_t *buf, size_t size) : buf(buf), size(size), pos(0) {}
+
+    inline void bytes(const void *data, size_t count)
+    {
+        if (count != 0 && pos + count <= size) {
+            std::memcpy(buf + pos, data, count);
+        }
+        pos += count;
+    }
+
+    template <typename T>
+    inline void value(const T &val)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "state values are copied bytewise");
+        bytes(&val, sizeof(T));
+    }
+
+    /// Bytes written, or that would have been written if the buffer was big
+    /// enough.
+    inline size_t used() const { return pos; }
+    inline bool overflowed() const { return pos > size; }
+
+private:
+    uint8_t *buf;
+    size_t size;
+    size_t pos;
+};
+
+/// Reads back what a Writer wrote. Reading past the end zero-fills and marks
+/// the reader as failed.
+class Reader {
+public:
+    Reader(const uint8_t *buf, size_t size) : buf(buf), size(size), pos(0) {}
+
+    inline void bytes(void *data, size_t count)
+    {
+        if (pos + count <= size) {
+            std::memcpy(data, buf + pos, count);
+        } else if (count != 0) {
+            std::memset(data, 0, count);
+        }
+        pos += count;
+    }
+
+    template <typename T>
+    inline void value(T &val)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "state values are copied bytewise");
+        bytes(&val, sizeof(T));
+    }
+
+    /// Skips count bytes and returns where they are in the buffer, for
+    /// callers that compare before copying. Returns nullptr (and fails) if
+    /// they run past the end.
+    inline const uint8_t *view(size_t count)
+    {
+        const uint8_t *data = (pos + count <= size) ? buf + pos : nullptr;
+        pos += count;
+        return data;
+    }
+
+    inline size_t used() const { return pos; }
+    inline bool failed() const { return pos > size; }
+
+private:
+    const uint8_t *buf;
+    size_t size;
+    size_t pos;
+};
+
+}   // Namespace state.
@@ -0,0 +1,52 @@
+// thread-pool.h : Work-stealing thread pool. Every worker has its own task
+// queue and steals from the others once it runs dry.
+//
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    /// Starts given number of workers, at least one.
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+    /// Finishes all submitted tasks, then joins the workers.
+    ~ThreadPool();
+
+    /// Queues task on the next worker, round robin.
+    void submit(std::function<void()> task);
+    /// Blocks until every submitted task has finished.
+    void wait();
+
+    inline unsigned size() const { return unsigned(workers.size()); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void work(unsigned index);
+    /// Takes the newest task of worker index, or the oldest of another one.
+    bool pop(unsigned index, std::function<void()> &task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    // Guards the counters below.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    size_t queued = 0;      // Submitted, not started.
+    size_t pending = 0;     // Submitted, not finished.
+    unsigned next_queue = 0;
+    bool stopping = false;
+};
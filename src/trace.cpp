@@ -0,0 +1,267 @@
+// trace.cpp
+//
+#include "trace.h"
+#include "cpu/opcodes.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace trace {
+
+namespace {
+
+/// Operand in 6502 assembler syntax, e.g. "($44),Y".
+void format_operand(const Record &rec, const cpu::OpcodeInfo &info, fmt::memory_buffer &out)
+{
+    const uint8_t low = rec.code[1];
+    const uint16_t word = uint16_t(rec.code[1] | (rec.code[2] << 8));
+    auto it = std::back_inserter(out);
+
+    switch (info.mode) {
+    case cpu::AddrMode::Implied:         break;
+    case cpu::AddrMode::Accumulator:     fmt::format_to(it, " A"); break;
+    case cpu::AddrMode::Immediate:       fmt::format_to(it, " #${:02X}", low); break;
+    case cpu::AddrMode::ZeroPage:        fmt::format_to(it, " ${:02X}", low); break;
+    case cpu::AddrMode::ZeroPageX:       fmt::format_to(it, " ${:02X},X", low); break;
+    case cpu::AddrMode::ZeroPageY:       fmt::format_to(it, " ${:02X},Y", low); break;
+    case cpu::AddrMode::Relative:
+        fmt::format_to(it, " ${:04X}", uint16_t(rec.pc + 2 + int8_t(low)));
+        break;
+    case cpu::AddrMode::Absolute:        fmt::format_to(it, " ${:04X}", word); break;
+    case cpu::AddrMode::AbsoluteX:       fmt::format_to(it, " ${:04X},X", word); break;
+    case cpu::AddrMode::AbsoluteY:       fmt::format_to(it, " ${:04X},Y", word); break;
+    case cpu::AddrMode::Indirect:        fmt::format_to(it, " (${:04X})", word); break;
+    case cpu::AddrMode::IndexedIndirect: fmt::format_to(it, " (${:02X},X)", low); break;
+    case cpu::AddrMode::IndirectIndexed: fmt::format_to(it, " (${:02X}),Y", low); break;
+    }
+}
+
+/// Parses the number at line[pos], skipping leading spaces. Returns false if
+/// there are no digits.
+template <typename T>
+bool number(std::string_view line, size_t pos, int base, T &val)
+{
+    while (pos < line.size() && line[pos] == ' ') {
+        pos++;
+    }
+    uint64_t result = 0;
+    size_t digits = 0;
+    for (; pos < line.size(); pos++, digits++) {
+        const char c = line[pos];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (base == 16 && c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else if (base == 16 && c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else {
+            break;
+        }
+        result = result * uint64_t(base) + uint64_t(digit);
+    }
+    val = T(result);
+    return digits > 0;
+}
+
+/// Number following key, searched from pos on.
+template <typename T>
+bool field(std::string_view line, size_t pos, std::string_view key, int base, T &val)
+{
+    pos = line.find(key, pos);
+    return pos != std::string_view::npos && number(line, pos + key.size(), base, val);
+}
+
+}   // Anonymous namespace.
+
+// C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+void format(const Record &rec, fmt::memory_buffer &out)
+{
+    const cpu::OpcodeInfo &info = cpu::OPCODES[rec.code[0]];
+    const int bytes = (info.bytes > 0) ? info.bytes : 1;
+    auto it = std::back_inserter(out);
+
+    fmt::format_to(it, "{:04X}  {:02X}", rec.pc, rec.code[0]);
+    for (int i = 1; i < 3; i++) {
+        if (i < bytes) {
+            fmt::format_to(it, " {:02X}", rec.code[i]);
+        } else {
+            fmt::format_to(it, "   ");
+        }
+    }
+
+    // Unofficial opcodes are marked with a '*' in front of the mnemonic.
+    const size_t start = out.size();
+    fmt::format_to(it, " {}{}", cpu::unofficial(rec.code[0]) ? '*' : ' ', cpu::mnemonic(info.instr));
+    format_operand(rec, info, out);
+    // Registers start at column 48.
+    const size_t used = out.size() - start;
+    for (size_t i = used; i < 34; i++) {
+        out.push_back(' ');
+    }
+
+    fmt::format_to(it, "A:{:02X} X:{:02X} Y:{:02X} P:{:02X} SP:{:02X} PPU:{:3},{:3} CYC:{}\n",
+                   rec.a, rec.x, rec.y, rec.p, rec.sp, rec.scanline, rec.dot, rec.cycle);
+}
+
+bool parse(std::string_view line, Record &rec)
+{
+    rec = Record{};
+    if (line.size() < 16 || !number(line.substr(0, 4), 0, 16, rec.pc)) {
+        return false;
+    }
+    // Up to three bytes in columns 6-13.
+    for (int i = 0; i < 3; i++) {
+        const size_t col = 6 + size_t(i) * 3;
+        if (line[col] == ' ' || !number(line.substr(col, 2), 0, 16, rec.code[i])) {
+            break;
+        }
+    }
+
+    // Registers start at column 48, the disassembly before may contain
+    // anything.
+    const size_t regs = line.find("A:", 40);
+    if (regs == std::string_view::npos) {
+        return false;
+    }
+    const bool ok = field(line, regs, "A:", 16, rec.a) && field(line, regs, "X:", 16, rec.x)
+                 && field(line, regs, "Y:", 16, rec.y) && field(line, regs, " P:", 16, rec.p)
+                 && field(line, regs, "SP:", 16, rec.sp);
+    const size_t ppu = line.find("PPU:", regs);
+    if (ppu != std::string_view::npos) {
+        number(line, ppu + 4, 10, rec.scanline);
+        const size_t comma = line.find(',', ppu);
+        if (comma != std::string_view::npos) {
+            number(line, comma + 1, 10, rec.dot);
+        }
+    }
+    field(line, regs, "CYC:", 10, rec.cycle);
+    return ok;
+}
+
+Reader::Reader()
+    : fmt(Format::Text), pos(0), count(0)
+{
+}
+
+NesError Reader::open(const std::string &path)
+{
+    NesError err = file.open(path);
+    if (err != NesError::Success) {
+        return err;
+    }
+    fmt = Format::Text;
+    pos = 0;
+    count = 0;
+
+    FileHeader header;
+    if (file.size() >= sizeof(header)) {
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.magic == MAGIC) {
+            if (header.version != VERSION || header.record_size != sizeof(Record)) {
+                file.close();
+                return NesError::Err;
+            }
+            fmt = Format::Binary;
+            pos = sizeof(header);
+        }
+    }
+    return NesError::Success;
+}
+
+bool Reader::next(Record &rec)
+{
+    if (fmt == Format::Binary) {
+        if (pos + sizeof(Record) > file.size()) {
+            return false;
+        }
+        std::memcpy(&rec, file.data() + pos, sizeof(Record));
+        pos += sizeof(Record);
+        count++;
+        return true;
+    }
+
+    const char *text = reinterpret_cast<const char *>(file.data());
+    while (pos < file.size()) {
+        const char *start = text + pos;
+        const char *end = static_cast<const char *>(std::memchr(start, '\n', file.size() - pos));
+        const size_t len = end ? size_t(end - start) : file.size() - pos;
+        pos += len + 1;
+        if (parse(std::string_view(start, len), rec)) {
+            count++;
+            return true;
+        }
+    }
+    return false;
+}
+
+Writer::Writer(size_t capacity)
+    : ring(capacity), format(Format::Text), stopping(false)
+{
+}
+
+Writer::~Writer()
+{
+    close();
+}
+
+NesError Writer::open(const std::string &path, Format format)
+{
+    close();
+    file.open(path, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    if (!file.is_open()) {
+        return NesError::CouldNotOpenFile;
+    }
+    this->format = format;
+    if (format == Format::Binary) {
+        const FileHeader header = {MAGIC, VERSION, uint16_t(sizeof(Record)), 0};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+    stopping = false;
+    thread = std::thread(&Writer::drain, this);
+    return NesError::Success;
+}
+
+void Writer::close()
+{
+    if (thread.joinable()) {
+        stopping = true;
+        thread.join();
+    }
+    if (file.is_open()) {
+        file.close();
+    }
+}
+
+void Writer::drain()
+{
+    static constexpr size_t BATCH = 1024;
+    Record records[BATCH];
+    fmt::memory_buffer text;
+
+    for (;;) {
+        // Checked before popping so records pushed before close() still get
+        // written.
+        const bool last = stopping;
+        const size_t count = ring.pop(records, BATCH);
+        if (count == 0) {
+            if (last) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+
+        if (format == Format::Binary) {
+            file.write(reinterpret_cast<const char *>(records), std::streamsize(count * sizeof(Record)));
+            continue;
+        }
+        text.clear();
+        for (size_t i = 0; i < count; i++) {
+            trace::format(records[i], text);
+        }
+        file.write(text.data(), std::streamsize(text.size()));
+    }
+}
+
+}   // Namespace trace.
@@ -0,0 +1,122 @@
+// trace.h : Execution traces. The emulation thread pushes one fixed-size
+// record per instruction into a ring, a background thread writes them out as
+// nestest style text or as raw records.
+//
+#pragma once
+
+#include "mapped-file.h"
+#include "nes-error.h"
+#include "spsc-ring.h"
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace trace {
+
+/// CPU state right before an instruction executes.
+struct Record {
+    uint64_t cycle;         // CPU cycles since power up.
+    uint16_t pc;
+    uint8_t code[3];        // Opcode and operand bytes, unused ones are 0.
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t p;
+    uint8_t sp;
+    uint16_t scanline;      // PPU position.
+    uint16_t dot;
+    uint16_t reserved;      // Keeps binary traces free of padding garbage.
+};
+static_assert(sizeof(Record) == 24, "binary traces store Records as is");
+
+enum class Format {
+    Text,       // nestest.log layout, without the "= xx" memory annotations.
+    Binary,     // FileHeader followed by raw Records.
+};
+
+/// Start of binary trace files.
+struct FileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint64_t reserved;
+};
+static constexpr uint32_t MAGIC   = 0x5453454e;   // "NEST"
+static constexpr uint16_t VERSION = 1;
+
+/// Appends rec as one nestest.log line, newline included.
+void format(const Record &rec, fmt::memory_buffer &out);
+/// Parses a nestest.log line. Memory annotations are ignored.
+/// Returns false if line isn't one.
+bool parse(std::string_view line, Record &rec);
+
+/// Reads a trace file of either format from a memory mapping, record by
+/// record. Nothing is allocated per record.
+class Reader {
+public:
+    Reader();
+
+    /// Maps the trace at path and detects its format. Returns
+    /// CouldNotOpenFile if it can't be mapped, Err for binary traces of
+    /// another version.
+    NesError open(const std::string &path);
+
+    /// Reads the next record. Text lines that aren't trace lines are
+    /// skipped. Returns false at the end of the file.
+    bool next(Record &rec);
+
+    inline Format format() const { return fmt; }
+    /// Records read so far.
+    inline size_t records() const { return count; }
+
+private:
+    MappedFile file;
+    Format fmt;
+    size_t pos;
+    size_t count;
+};
+
+/// Writes records pushed by one thread to a file from a background thread.
+class Writer {
+public:
+    /// Ring of capacity records between the threads.
+    explicit Writer(size_t capacity = 64 * 1024);
+    Writer(const Writer&) = delete;
+    Writer &operator=(const Writer&) = delete;
+    /// Calls close().
+    ~Writer();
+
+    /// Creates the file at path and starts the background thread.
+    /// Returns CouldNotOpenFile if the file can't be created.
+    NesError open(const std::string &path, Format format);
+    /// Writes out everything pushed so far and closes the file.
+    void close();
+
+    /// Queues rec. Waits for the background thread if the ring is full, a
+    /// trace never loses records.
+    inline void push(const Record &rec)
+    {
+        while (!ring.push(rec)) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    /// Background thread.
+    void drain();
+
+    SpscRing<Record> ring;
+    std::ofstream file;
+    Format format;
+    std::thread thread;
+    std::atomic<bool> stopping;
+};
+
+}   // Namespace trace.
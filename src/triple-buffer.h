@@ -0,0 +1,58 @@
+// triple-buffer.h : Lock-free triple buffer for handing the latest of a stream
+// of values (frames) from one producer thread to one consumer thread. Neither
+// side ever waits for the other, the consumer just skips values it was too
+// slow to see.
+//
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer()
+        : buffers(std::make_unique<T[]>(3)), back_index(0), front_index(1), middle(2)
+    {
+    }
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer &operator=(const TripleBuffer&) = delete;
+
+    /// Producer only. The buffer to fill, owned by the producer until
+    /// publish().
+    inline T &back() { return buffers[back_index]; }
+    /// Producer only. Hands back() to the consumer, replacing a value it
+    /// hasn't taken yet, and takes the spare buffer as the new back().
+    inline void publish()
+    {
+        const uint8_t old = middle.exchange(uint8_t(back_index | FRESH), std::memory_order_acq_rel);
+        back_index = old & INDEX;
+    }
+
+    /// Consumer only. Takes the newest published value as front(). Returns
+    /// false, leaving front() alone, if nothing was published since the last
+    /// call.
+    inline bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        const uint8_t old = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = old & INDEX;
+        return true;
+    }
+    /// Consumer only. The value update() took last, owned by the consumer.
+    inline const T &front() const { return buffers[front_index]; }
+
+private:
+    // middle holds the index of the buffer in between plus FRESH if the
+    // producer put it there since the consumer last looked.
+    static constexpr uint8_t INDEX = 0x03;
+    static constexpr uint8_t FRESH = 0x04;
+
+    std::unique_ptr<T[]> buffers;
+    uint8_t back_index;
+    uint8_t front_index;
+    alignas(64) std::atomic<uint8_t> middle;
+};
@@ -0,0 +1,208 @@
+// conformance-test.cpp : Runs CPU test ROMs headlessly. The ROMs aren't part of
+// the repository, they are looked up in NES_TEST_ROM_DIR (a CMake cache
+// variable, overridden by the NES_TEST_ROMS environment variable):
+//
+//   nestest.nes, nestest.log   nestest and its golden trace.
+//   blargg/**/*.nes            ROMs reporting through the $6000 protocol,
+//                              e.g. instr_test-v5 and instr_timing.
+//
+// Tests whose ROMs are missing are skipped.
+//
+#include "console.h"
+#include "trace.h"
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+fs::path rom_dir()
+{
+    const char *dir = std::getenv("NES_TEST_ROMS");
+    return (dir != nullptr) ? dir : NES_TEST_ROM_DIR;
+}
+
+std::string describe(const trace::Record &rec)
+{
+    fmt::memory_buffer line;
+    trace::format(rec, line);
+    return fmt::to_string(line);
+}
+
+bool same_cpu_state(const trace::Record &a, const trace::Record &b)
+{
+    return a.pc == b.pc && std::equal(a.code, a.code + 3, b.code)
+        && a.a == b.a && a.x == b.x && a.y == b.y && a.p == b.p && a.sp == b.sp
+        && a.cycle == b.cycle;
+}
+
+}   // Anonymous namespace.
+
+// nestest's automation mode starts at $C000 and ends on the RTS at $C66E.
+// $02 holds the result of the official opcode tests, $03 that of the
+// unofficial ones, 0 meaning passed. Every instruction up to there is
+// compared with the golden trace, PPU positions aside.
+TEST(Nestest, Automation)
+{
+    const fs::path rom = rom_dir() / "nestest.nes";
+    const fs::path log = rom_dir() / "nestest.log";
+    if (!fs::exists(rom) || !fs::exists(log)) {
+        GTEST_SKIP() << "nestest.nes and nestest.log not found in " << rom_dir();
+    }
+
+    auto console = std::make_unique<Console>();
+    ASSERT_EQ(console->load(rom.string()), NesError::Success);
+    trace::Reader golden;
+    ASSERT_EQ(golden.open(log.string()), NesError::Success);
+
+    console->cpu().set_program_counter(0xc000);
+    trace::Record expected, actual;
+    bool finished = false;
+    while (golden.next(expected)) {
+        actual = {};
+        console->cpu().trace_record(actual);
+        console->ppu().run_until(console->cpu().cycles());
+        actual.scanline = uint16_t(console->ppu().scanline());
+        actual.dot = uint16_t(console->ppu().dot());
+        ASSERT_TRUE(same_cpu_state(expected, actual))
+            << "Diverged at line " << golden.records() << "\n"
+            << "expected: " << describe(expected)
+            << "actual:   " << describe(actual);
+
+        if (actual.pc == 0xc66e) {
+            finished = true;
+            break;
+        }
+        ASSERT_EQ(console->step(), NesError::Success)
+            << "Invalid opcode at line " << golden.records() << "\n"
+            << "expected: " << describe(expected);
+    }
+    ASSERT_TRUE(finished) << "The log ended after " << golden.records()
+                          << " lines, before the RTS at $C66E";
+
+    EXPECT_EQ(console->ram()[0x02], 0x00) << "Official opcode tests failed";
+    EXPECT_EQ(console->ram()[0x03], 0x00) << "Unofficial opcode tests failed";
+}
+
+namespace {
+
+/// blargg's test ROMs write $DE $B0 $61 to $6001-$6003 once $6000 holds a
+/// status: $80 while running, $81 if the reset button should be pressed
+/// after at least 100ms, otherwise the result code, 0 meaning passed. $6004
+/// on is a zero terminated message.
+class BlarggStatus {
+public:
+    explicit BlarggStatus(const bus::Bus &bus) : bus(bus) {}
+
+    static constexpr uint8_t RUNNING = 0x80;
+    static constexpr uint8_t NEEDS_RESET = 0x81;
+
+    inline bool valid() const
+    {
+        return bus.peek(0x6001) == 0xde && bus.peek(0x6002) == 0xb0 && bus.peek(0x6003) == 0x61;
+    }
+    inline uint8_t code() const { return bus.peek(0x6000); }
+
+    std::string message() const
+    {
+        std::string text;
+        for (uint16_t addr = 0x6004; addr < 0x8000; addr++) {
+            const char c = char(bus.peek(addr));
+            if (c == '\0') {
+                break;
+            }
+            text += c;
+        }
+        return text;
+    }
+
+private:
+    const bus::Bus &bus;
+};
+
+std::vector<fs::path> blargg_roms()
+{
+    std::vector<fs::path> roms;
+    std::error_code err;
+    const fs::path dir = rom_dir() / "blargg";
+    for (fs::recursive_directory_iterator it(dir, err), end; !err && it != end; it.increment(err)) {
+        if (it->path().extension() == ".nes") {
+            roms.push_back(it->path());
+        }
+    }
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+/// Test name of rom: its path below the blargg directory with everything but
+/// letters and digits turned into underscores.
+std::string rom_name(const testing::TestParamInfo<fs::path> &info)
+{
+    std::string name = info.param.lexically_relative(rom_dir() / "blargg").replace_extension().string();
+    for (char &c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+            c = '_';
+        }
+    }
+    return name;
+}
+
+}   // Anonymous namespace.
+
+class Blargg : public testing::TestWithParam<fs::path> {};
+
+TEST_P(Blargg, Passes)
+{
+    // The longest ROMs take about 30 seconds.
+    constexpr int MAX_FRAMES = 60 * 60;
+    // Frames to wait before pressing reset, a bit over 100ms.
+    constexpr int RESET_DELAY = 8;
+
+    auto console = std::make_unique<Console>();
+    ASSERT_EQ(console->load(GetParam().string()), NesError::Success);
+    const BlarggStatus status(console->bus());
+
+    int reset_in = -1;
+    for (int frame = 0; frame < MAX_FRAMES; frame++) {
+        ASSERT_EQ(console->run_frame(), NesError::Success)
+            << "at $" << fmt::format("{:04X}", console->cpu().pc());
+        if (!status.valid()) {
+            continue;
+        }
+        if (status.code() == BlarggStatus::NEEDS_RESET) {
+            if (reset_in < 0) {
+                reset_in = RESET_DELAY;
+            } else if (--reset_in == 0) {
+                console->reset();
+                reset_in = -1;
+            }
+        } else if (status.code() != BlarggStatus::RUNNING) {
+            EXPECT_EQ(int(status.code()), 0) << status.message();
+            return;
+        }
+    }
+    FAIL() << "No result after " << MAX_FRAMES << " frames. "
+           << (status.valid() ? status.message() : "The ROM never wrote a status.");
+}
+
+// Shows up as skipped when there is nothing to instantiate Blargg with.
+TEST(BlarggRoms, Found)
+{
+    if (blargg_roms().empty()) {
+        GTEST_SKIP() << "No ROMs in " << rom_dir() / "blargg";
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Roms, Blargg, testing::ValuesIn(blargg_roms()), rom_name);
+GTEST_ALLOW_UNINSTANTIATED_PARAMETERIZED_TEST(Blargg);
@@ -0,0 +1,146 @@
+// rewind-test.cpp : Round trips through the rewind history. The cartridge is
+// written on the fly, so these run without any test ROMs.
+//
+#include "console.h"
+#include "rewind.h"
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Writes an NROM cartridge to path that keeps incrementing RAM, so each
+/// frame's state differs from the last in a few hundred bytes between long
+/// unchanged runs.
+bool write_counter_rom(const fs::path &path)
+{
+    const uint8_t code[] = {
+        0xa2, 0xff, 0x9a,               // LDX #$FF, TXS
+        0xe6, 0x00,                     // loop: INC $00
+        0xa6, 0x00,                     // LDX $00
+        0xfe, 0x00, 0x03,               // INC $0300,X
+        0x4c, 0x03, 0x80,               // JMP loop
+    };
+    std::vector<uint8_t> prg(16 * 1024, 0xea);
+    std::copy(std::begin(code), std::end(code), prg.begin());
+    const uint8_t vectors[6] = { 0x00, 0x80, 0x00, 0x80, 0x00, 0x80 };
+    std::copy(vectors, vectors + 6, prg.end() - 6);
+    const std::vector<uint8_t> chr(8 * 1024);
+
+    const uint8_t header[16] = { 'N', 'E', 'S', 0x1a, 1, 1 };
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(prg.data()), std::streamsize(prg.size()));
+    out.write(reinterpret_cast<const char *>(chr.data()), std::streamsize(chr.size()));
+    return bool(out);
+}
+
+}   // Anonymous namespace.
+
+class RewindTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        rom = fs::temp_directory_path() / fmt::format("nes-rewind-test-{:08x}.nes", std::random_device()());
+        ASSERT_TRUE(write_counter_rom(rom));
+        console = std::make_unique<Console>();
+        ASSERT_EQ(console->load(rom.string()), NesError::Success);
+    }
+
+    void TearDown() override
+    {
+        std::error_code err;
+        fs::remove(rom, err);
+    }
+
+    /// Runs count frames, recording each one into rewind and keeping the
+    /// state it ended in.
+    void run(Rewind &rewind, int count)
+    {
+        for (int i = 0; i < count; i++) {
+            ASSERT_EQ(console->run_frame(), NesError::Success);
+            rewind.record(*console);
+            std::vector<uint8_t> &state = states[console->ppu().frame_count()];
+            state.resize(console->state_size());
+            ASSERT_EQ(console->snapshot(state.data(), state.size()), NesError::Success);
+        }
+    }
+
+    /// Seeks to frame and checks the console is back in the state it ended
+    /// that frame in.
+    void expect_seek(Rewind &rewind, uint64_t frame)
+    {
+        ASSERT_EQ(rewind.seek(*console, frame), NesError::Success) << "frame " << frame;
+        ASSERT_EQ(console->ppu().frame_count(), frame);
+        std::vector<uint8_t> state(console->state_size());
+        ASSERT_EQ(console->snapshot(state.data(), state.size()), NesError::Success);
+        EXPECT_TRUE(state == states[frame]) << "State differs after seeking to frame " << frame;
+    }
+
+    fs::path rom;
+    std::unique_ptr<Console> console;
+    // Reference states by frame. Runs are deterministic, so frames run again
+    // after a seek end in the same states.
+    std::map<uint64_t, std::vector<uint8_t>> states;
+};
+
+TEST_F(RewindTest, SeeksToKeyframesAndDeltas)
+{
+    Rewind rewind(1 << 20, 1, 10);
+    run(rewind, 45);
+    ASSERT_EQ(rewind.count(), 45u);
+
+    const uint64_t first = rewind.oldest_frame();
+    // Seeking drops what comes after, so go backwards.
+    for (uint64_t frame : { first + 44, first + 37, first + 30, first + 29, first + 12, first }) {
+        expect_seek(rewind, frame);
+        EXPECT_EQ(rewind.newest_frame(), frame);
+    }
+    EXPECT_EQ(rewind.seek(*console, first + 1), NesError::InvalidState);
+}
+
+TEST_F(RewindTest, KeepsWorkingAfterTheRingWraps)
+{
+    // Room for a few keyframes with their deltas, so old ones are evicted
+    // and the ring wraps many times.
+    const size_t budget = console->state_size() * 2;
+    Rewind rewind(budget, 1, 8);
+    run(rewind, 300);
+    EXPECT_LE(rewind.used(), budget);
+    EXPECT_GT(rewind.oldest_frame(), states.begin()->first);
+
+    const uint64_t newest = rewind.newest_frame();
+    expect_seek(rewind, rewind.oldest_frame() + (newest - rewind.oldest_frame()) / 2);
+    // Record on from there and wrap again.
+    run(rewind, 200);
+    EXPECT_LE(rewind.used(), budget);
+    expect_seek(rewind, rewind.newest_frame() - 5);
+    expect_seek(rewind, rewind.oldest_frame());
+}
+
+TEST_F(RewindTest, FailedSeekKeepsRecording)
+{
+    Rewind rewind(1 << 20, 1, 10);
+    run(rewind, 25);
+
+    // Restoring into a console without a cartridge fails after the history
+    // decoded an older keyframe.
+    Console empty;
+    EXPECT_NE(rewind.seek(empty, rewind.oldest_frame() + 3), NesError::Success);
+
+    run(rewind, 3);
+    const uint64_t newest = rewind.newest_frame();
+    expect_seek(rewind, newest);
+    expect_seek(rewind, newest - 1);
+}
@@ -0,0 +1,82 @@
+// trace-convert.cpp : Converts execution traces between nestest text and the
+// binary record format written by trace::Writer.
+//
+#include "nes-error.h"
+#include "trace.h"
+
+#include <fmt/format.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void usage()
+{
+    fmt::print(stderr,
+        "usage: nes-trace-convert (--text | --binary) <input> <output>\n"
+        "\n"
+        "Reads a text (nestest.log layout) or binary trace and writes it in the\n"
+        "given format.\n");
+}
+
+}   // Anonymous namespace.
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4) {
+        usage();
+        return 2;
+    }
+    trace::Format format;
+    if (std::strcmp(argv[1], "--text") == 0) {
+        format = trace::Format::Text;
+    } else if (std::strcmp(argv[1], "--binary") == 0) {
+        format = trace::Format::Binary;
+    } else {
+        usage();
+        return 2;
+    }
+
+    // The input has to be good before the output is truncated, which would
+    // also pull the mapped input away if both are the same file.
+    trace::Reader input;
+    if (input.open(argv[2]) != NesError::Success) {
+        fmt::print(stderr, "Failed to read {}\n", argv[2]);
+        return 1;
+    }
+    std::error_code err;
+    if (fs::equivalent(argv[2], argv[3], err)) {
+        fmt::print(stderr, "{} would overwrite the input\n", argv[3]);
+        return 1;
+    }
+
+    std::ofstream output(argv[3], std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    if (!output.is_open()) {
+        fmt::print(stderr, "Failed to open {}\n", argv[3]);
+        return 1;
+    }
+    if (format == trace::Format::Binary) {
+        const trace::FileHeader header = {trace::MAGIC, trace::VERSION, uint16_t(sizeof(trace::Record)), 0};
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    trace::Record rec;
+    fmt::memory_buffer text;
+    while (input.next(rec)) {
+        if (format == trace::Format::Binary) {
+            output.write(reinterpret_cast<const char *>(&rec), sizeof(rec));
+        } else {
+            text.clear();
+            trace::format(rec, text);
+            output.write(text.data(), std::streamsize(text.size()));
+        }
+    }
+    fmt::print("{} records\n", input.records());
+    return 0;
+}
@@ -0,0 +1,185 @@
+// trace-diff.cpp : Compares two execution traces (nestest text or binary)
+// record by record and reports where they diverge.
+//
+#include "nes-error.h"
+#include "trace.h"
+
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+namespace {
+
+// Fields a comparison looks at.
+constexpr uint32_t PC     = 1 << 0;
+constexpr uint32_t OPCODE = 1 << 1;
+constexpr uint32_t A      = 1 << 2;
+constexpr uint32_t X      = 1 << 3;
+constexpr uint32_t Y      = 1 << 4;
+constexpr uint32_t P      = 1 << 5;
+constexpr uint32_t SP     = 1 << 6;
+constexpr uint32_t CYCLE  = 1 << 7;
+constexpr uint32_t PPU    = 1 << 8;
+
+/// Fields in which a and b differ.
+uint32_t compare(const trace::Record &a, const trace::Record &b, uint32_t fields)
+{
+    uint32_t diff = 0;
+    diff |= (a.pc != b.pc) ? PC : 0;
+    diff |= (a.code[0] != b.code[0]) ? OPCODE : 0;
+    diff |= (a.a != b.a) ? A : 0;
+    diff |= (a.x != b.x) ? X : 0;
+    diff |= (a.y != b.y) ? Y : 0;
+    diff |= (a.p != b.p) ? P : 0;
+    diff |= (a.sp != b.sp) ? SP : 0;
+    diff |= (a.cycle != b.cycle) ? CYCLE : 0;
+    diff |= (a.scanline != b.scanline || a.dot != b.dot) ? PPU : 0;
+    return diff & fields;
+}
+
+/// The last few record pairs, for printing context before a divergence.
+struct History {
+    static constexpr size_t MAX = 64;
+    trace::Record expected[MAX];
+    trace::Record actual[MAX];
+    size_t count = 0;
+
+    void add(const trace::Record &e, const trace::Record &a)
+    {
+        expected[count % MAX] = e;
+        actual[count % MAX] = a;
+        count++;
+    }
+};
+
+void print_record(char mark, size_t index, const trace::Record &rec, fmt::memory_buffer &line)
+{
+    line.clear();
+    trace::format(rec, line);
+    fmt::print("{} {:>9}  {}", mark, index, std::string_view(line.data(), line.size()));
+}
+
+void print_fields(uint32_t diff)
+{
+    static constexpr const char *names[] = {"PC", "opcode", "A", "X", "Y", "P", "SP", "CYC", "PPU"};
+    fmt::print("  differs in:");
+    for (int i = 0; i < 9; i++) {
+        if (diff & (1u << i)) {
+            fmt::print(" {}", names[i]);
+        }
+    }
+    fmt::print("\n");
+}
+
+void usage()
+{
+    fmt::print(stderr,
+        "usage: nes-trace-diff [-n count] [-C lines] [--no-cycles] [--ppu] <expected> <actual>\n"
+        "\n"
+        "Compares PC, opcode, A, X, Y, P, SP and CYC of two traces, text (nestest.log\n"
+        "layout) or binary. Prints the first count divergences (default 10) with\n"
+        "lines of context (default 3, at most 64). --no-cycles ignores CYC, --ppu also\n"
+        "compares the PPU position. Exits with 1 if the traces differ.\n");
+}
+
+}   // Anonymous namespace.
+
+int main(int argc, char *argv[])
+{
+    size_t max_reports = 10;
+    size_t context = 3;
+    uint32_t fields = PC | OPCODE | A | X | Y | P | SP | CYCLE;
+    const char *paths[2] = {};
+    int path_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "-n") == 0 && has_value) {
+            max_reports = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-C") == 0 && has_value) {
+            context = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--no-cycles") == 0) {
+            fields &= ~CYCLE;
+        } else if (std::strcmp(argv[i], "--ppu") == 0) {
+            fields |= PPU;
+        } else if (argv[i][0] != '-' && path_count < 2) {
+            paths[path_count++] = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (path_count != 2) {
+        usage();
+        return 2;
+    }
+    context = (context < History::MAX) ? context : History::MAX - 1;
+
+    trace::Reader expected, actual;
+    for (int i = 0; i < 2; i++) {
+        if ((i == 0 ? expected : actual).open(paths[i]) != NesError::Success) {
+            fmt::print(stderr, "Failed to read {}\n", paths[i]);
+            return 2;
+        }
+    }
+
+    // Heap allocated once, records are only ever copied into it.
+    auto history = std::make_unique<History>();
+    fmt::memory_buffer line;
+    size_t reports = 0;
+    size_t divergences = 0;
+    // Records after the last divergence still to print as context.
+    size_t trailing = 0;
+
+    trace::Record e, a;
+    for (;;) {
+        const bool has_e = expected.next(e);
+        const bool has_a = actual.next(a);
+        if (!has_e || !has_a) {
+            if (has_e != has_a) {
+                fmt::print("{} ends after {} records, {} continues\n",
+                           has_e ? paths[1] : paths[0], history->count,
+                           has_e ? paths[0] : paths[1]);
+                divergences++;
+            }
+            break;
+        }
+
+        const size_t index = history->count;
+        const uint32_t diff = compare(e, a, fields);
+        if (diff != 0) {
+            divergences++;
+        }
+        if (diff != 0 && reports < max_reports) {
+            if (trailing == 0) {
+                fmt::print("@@ record {} @@\n", index);
+                const size_t before = (index < context) ? index : context;
+                for (size_t i = index - before; i < index; i++) {
+                    print_record(' ', i, history->expected[i % History::MAX], line);
+                }
+            }
+            print_record('-', index, e, line);
+            print_record('+', index, a, line);
+            print_fields(diff);
+            reports++;
+            trailing = context;
+        } else if (trailing > 0) {
+            if (diff == 0) {
+                print_record(' ', index, e, line);
+            } else {
+                print_record('-', index, e, line);
+                print_record('+', index, a, line);
+                print_fields(diff);
+            }
+            trailing--;
+        }
+        history->add(e, a);
+    }
+
+    fmt::print("{} records compared, {} divergences\n", history->count, divergences);
+    return divergences ? 1 : 0;
+}